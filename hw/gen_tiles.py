@@ -0,0 +1,85 @@
+import os
+from PIL import Image, ImageDraw
+
+IMAGE_DIR = "images"
+TILESET_FILE = "obstacle_tiles.hex"
+PALETTE_FILE = "obstacle_palette.hex"
+HITBOX_FILE = "../sw/obstacle_boxes.h"
+TILE_DIM = (32, 32)  # width × height
+TILES = 16           # tile numbers are 4 bits
+COLORS = 16          # color index 0 is transparent
+
+# Tile number = obstacle code (geo_dash.h); the hardware draws
+# OBS_BLOCK_PLATFORM as a square with a platform on the row above it
+TILE_IMAGES = {
+    1: ("OBS_SPIKE", "regular_spike.png"),
+    2: ("OBS_BLOCK", "square.png"),
+    3: ("OBS_PLATFORM", "platform.png"),
+    4: ("OBS_JUMP_PAD", None),  # drawn below
+    5: ("OBS_GRAVITY_PORTAL", "portal.png"),
+    7: ("OBS_SHORT_SPIKE", "short_spike.png"),
+    8: ("OBS_RAZOR", "razor.png"),
+    9: ("OBS_SLOPE", "slope.png"),
+}
+
+def jump_pad():
+    # No art for the pad: a yellow strip on the floor, which is also its hitbox
+    img = Image.new("RGBA", TILE_DIM, (0, 0, 0, 0))
+    draw = ImageDraw.Draw(img)
+    draw.rectangle((0, 24, 31, 31), fill=(255, 220, 0, 255))
+    draw.rectangle((0, 24, 31, 25), fill=(255, 255, 160, 255))
+    return img
+
+tiles = {}
+for tile, (name, filename) in TILE_IMAGES.items():
+    img = jump_pad() if filename is None else Image.open(os.path.join(IMAGE_DIR, filename))
+    img = img.convert("RGBA")
+    if img.size != TILE_DIM:
+        raise ValueError(f"{filename} is {img.size}, expected {TILE_DIM}.")
+    tiles[tile] = img
+
+# One palette for every tile: quantize all the opaque pixels together
+opaque = [p[:3] for img in tiles.values()
+          for y in range(32) for x in range(32)
+          for p in [img.getpixel((x, y))] if p[3] >= 128]
+strip = Image.new("RGB", (len(opaque), 1))
+strip.putdata(opaque)
+quantized = strip.quantize(colors=COLORS - 1, method=Image.Quantize.MEDIANCUT)
+flat = quantized.getpalette()[:3 * (COLORS - 1)]
+palette = [(0, 0, 0)] + [tuple(flat[i:i + 3]) for i in range(0, len(flat), 3)]
+palette += [(0, 0, 0)] * (COLORS - len(palette))
+
+def nearest(rgb):
+    return min(range(1, COLORS), key=lambda i: sum((a - b) ** 2 for a, b in zip(rgb, palette[i])))
+
+# Tileset: 4-bit color indices, address {tile, y, x}; unused tiles stay clear
+memory = [0] * (TILES * 32 * 32)
+for tile, img in tiles.items():
+    for y in range(32):
+        for x in range(32):
+            r, g, b, a = img.getpixel((x, y))
+            if a >= 128:
+                memory[(tile << 10) | (y << 5) | x] = nearest((r, g, b))
+
+with open(TILESET_FILE, "w") as f:
+    for index in memory:
+        f.write(f"{index:X}\n")
+
+with open(PALETTE_FILE, "w") as f:
+    for r, g, b in palette:
+        f.write(f"{(r << 16) | (g << 8) | b:06X}\n")
+
+# Hitboxes for sw/physics.c: the bounding box of each tile's opaque pixels,
+# the same pixels the tileset draws
+with open(HITBOX_FILE, "w") as f:
+    f.write("// Generated by hw/gen_tiles.py from the art in hw/images; do not edit.\n")
+    f.write("// Each obstacle's opaque pixels in its 32x32 cell: x, y, w, h\n")
+    f.write("#ifndef _OBSTACLE_BOXES_H\n#define _OBSTACLE_BOXES_H\n\n")
+    for tile, (name, filename) in TILE_IMAGES.items():
+        alpha = tiles[tile].getchannel("A").point(lambda a: 255 if a >= 128 else 0)
+        left, top, right, bottom = alpha.getbbox()
+        f.write(f"#define {name + '_BOX':<22} {left}, {top}, {right - left}, {bottom - top}"
+                f"  // {filename or 'jump pad strip'}\n")
+    f.write("\n#endif // _OBSTACLE_BOXES_H\n")
+
+print(f"✅ Wrote {TILESET_FILE} ({len(tiles)} tiles), {PALETTE_FILE} ({COLORS} colors) and {HITBOX_FILE}.")
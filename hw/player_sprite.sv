@@ -8,13 +8,41 @@
  * 
  * Byte Offset  7 ... 0   Meaning
  *        0    | player_y_pos   | Player y position (0-480)
- *        2    | x_shift        | The current top leftmost map_block
+ *        2    | x_shift        | Tile layer scroll: pixel (4:0) and
+ *             |                | tile column (9:5) at the left edge
  *        4    | background_r   | Red component of background color (0-255)
  *        6    | background_g   | Green component
  *        8    | background_b   | Blue component
  *        10   | map_block      | A section of map containing an obstacle id
  *        12   | flags          | Start, Acknowledgment
  *        14   | output         | Output flags
+ *        16   | irq_control    | Write: bit 0 enables the vblank IRQ,
+ *             |                | bit 1 acknowledges a pending one
+ *        18   | tile_column    | Write: obstacle code (7:0) for tile
+ *             |                | column (12:8)
+ *        20   | bottom_r       | Background color at the bottom line
+ *        22   | bottom_g       |
+ *        24   | bottom_b       |
+ *
+ * irq goes high when the raster enters vertical blanking (line 480) and
+ * stays high until software acknowledges it.
+ *
+ * The level is drawn from a tilemap of 32 columns, one obstacle code
+ * each, so software uploads level columns and never pixels.  The map is
+ * a horizontal ring: pixel x shows tile layer pixel (x + x_shift) mod
+ * 1024, so one register write scrolls the whole playfield and only the
+ * column coming on screen needs uploading.  Level row 0 sits on the
+ * ground, its top
+ * at line GROUND_Y (220) as in sw/physics.h.  A pipeline as in tiles.sv
+ * turns each code and row into a tile, then a color index from the
+ * tileset, then a color from the palette; index 0 shows the background.
+ * The player is drawn over the tiles.
+ *
+ * The background is a vertical gradient from background_r/g/b on the top
+ * line to bottom_r/g/b on the bottom one, blended once per line with
+ * t = vcount * 273 / 256 (0-511 over the 480 lines).  Setting both colors
+ * the same gives a flat background.  The pipeline is four cycles (two
+ * pixels) deep, so the syncs and blanking are delayed to match.
  */
 
 module player_sprite(input logic        clk,
@@ -22,17 +50,32 @@ module player_sprite(input logic        clk,
         input logic [15:0]  writedata,
         input logic 	   write,
         input 		   chipselect,
-        input logic [2:0]  address,
+        input logic [3:0]  address,
+
+        output logic       irq,
 
         output logic [7:0] VGA_R, VGA_G, VGA_B,
         output logic 	   VGA_CLK, VGA_HS, VGA_VS,
                            VGA_BLANK_n,
         output logic 	   VGA_SYNC_n);
 
+    // Obstacle codes from sw/geo_dash.h that need more than one tile
+    localparam logic [7:0] OBS_BLOCK_PLATFORM = 8'd6;
+    localparam logic [3:0] TILE_BLOCK = 4'd2, TILE_PLATFORM = 4'd3;
+
+    // Lines are shifted down so tile rows start on GROUND_Y (220 + 4 = 7 * 32)
+    localparam logic [9:0] TILE_Y_OFFSET = 10'd4;
+    localparam logic [4:0] GROUND_TILE_ROW = 5'd7;
+
     logic [10:0]	   hcount;
     logic [9:0]     vcount;
+    logic           VGA_HS0, VGA_VS0, VGA_BLANK_n0;
 
     logic [7:0] 	   background_r, background_g, background_b;
+    logic [7:0]     bottom_r, bottom_g, bottom_b;
+    logic [7:0]     gradient_r, gradient_g, gradient_b;
+    logic [18:0]    gradient_line;
+    logic [8:0]     gradient_t;
 
     // REGISTERS
     logic [15:0] player_y_pos;
@@ -40,34 +83,154 @@ module player_sprite(input logic        clk,
     logic [7:0]  map_block;
     logic [7:0]  flags;
     logic [7:0]  output_flags;
+    logic        irq_enable;
+    logic        vblank_pending;
     
-   vga_counters counters(.clk50(clk), .*);
+   vga_counters counters(.clk50(clk),
+                         .VGA_HS( VGA_HS0 ), .VGA_VS( VGA_VS0 ),
+                         .VGA_BLANK_n( VGA_BLANK_n0 ), .*);
 
     always_ff @(posedge clk)
         if (reset) begin
             background_r <= 8'h0;
             background_g <= 8'h0;
             background_b <= 8'h80;
+            bottom_r <= 8'h0;
+            bottom_g <= 8'h0;
+            bottom_b <= 8'h80;
+            irq_enable <= 1'b0;
         end else if (chipselect && write)
         case (address)
-            3'h0: player_y_pos <= writedata;
-            3'h1: x_shift <= writedata;
-            3'h2: background_r <= writedata[7:0];
-            3'h3: background_g <= writedata[7:0];
-            3'h4: background_b <= writedata[7:0];
-            3'h5: map_block <= writedata[7:0];
-            3'h6: flags <= writedata[7:0];
-            3'h7: output_flags <= writedata[7:0];
+            4'h0: player_y_pos <= writedata;
+            4'h1: x_shift <= writedata;
+            4'h2: background_r <= writedata[7:0];
+            4'h3: background_g <= writedata[7:0];
+            4'h4: background_b <= writedata[7:0];
+            4'h5: map_block <= writedata[7:0];
+            4'h6: flags <= writedata[7:0];
+            4'h7: output_flags <= writedata[7:0];
+            4'h8: irq_enable <= writedata[0];
+            4'ha: bottom_r <= writedata[7:0];
+            4'hb: bottom_g <= writedata[7:0];
+            4'hc: bottom_b <= writedata[7:0];
         endcase
 
+    // Vblank interrupt: latch at the first blank line, clear on acknowledge
+    always_ff @(posedge clk)
+        if (reset)
+            vblank_pending <= 1'b0;
+        else if (vcount == 10'd480 && hcount == 11'd0)
+            vblank_pending <= 1'b1;
+        else if (chipselect && write && address == 4'h8 && writedata[1])
+            vblank_pending <= 1'b0;
+
+    assign irq = irq_enable & vblank_pending;
+
+    // One channel of the gradient: top + (bottom - top) * t / 512
+    function automatic logic [7:0] blend(input logic [7:0] top, bottom,
+                                         input logic [8:0] t);
+        logic signed [18:0] step;
+        step = ($signed({1'b0, bottom}) - $signed({1'b0, top})) *
+               $signed({1'b0, t});
+        return top + 8'(step >>> 9);
+    endfunction
+
+    // t steps once per line, so the blend is registered well ahead of use
+    assign gradient_line = vcount * 9'd273;
+    assign gradient_t = gradient_line[18:8] > 11'd511 ? 9'd511 : gradient_line[16:8];
+
+    always_ff @(posedge clk) begin
+        gradient_r <= blend(background_r, bottom_r, gradient_t);
+        gradient_g <= blend(background_g, bottom_g, gradient_t);
+        gradient_b <= blend(background_b, bottom_b, gradient_t);
+    end
+
+    // Tile pipeline: stage n holds what was computed n cycles ago
+    logic [9:0]  tile_x, tile_y;
+    logic [4:0]  tile_row;
+    logic [4:0]  x1, y1;                // Pixel within the tile
+    logic [4:0]  row1;                  // Level row, 0 on the ground
+    logic        row_valid1;
+    logic [7:0]  obstacle;              // Memory outputs
+    logic [3:0]  tile;
+    logic [3:0]  colorindex;
+    logic [23:0] tile_rgb;
+    logic [3:0]  colorindex3;
+    logic        player1, player2, player3;
+    logic        VGA_HS1, VGA_HS2, VGA_HS3;
+    logic        VGA_VS1, VGA_VS2, VGA_VS3;
+    logic        VGA_BLANK_n1, VGA_BLANK_n2, VGA_BLANK_n3;
+
+    assign tile_x = hcount[10:1] + x_shift[9:0];    // Wraps around the ring
+    assign tile_y = vcount + TILE_Y_OFFSET;
+    assign tile_row = tile_y[9:5];
+
+    twoportbram #(.DATA_BITS(8), .ADDRESS_BITS(5))  // Tile map: a code per column
+    tilemap(.clk1  ( clk ), .clk2 ( clk ),
+            .addr1 ( tile_x[9:5] ),
+            .we1   ( 1'b0 ), .din1( 8'h0 ), .dout1( obstacle ),
+            .addr2 ( writedata[12:8] ),
+            .we2   ( chipselect && write && address == 4'h9 ),
+            .din2  ( writedata[7:0] ), .dout2( ));
+
+    always_ff @(posedge clk) begin                  // Pipeline registers
+        { x1, y1 } <= { tile_x[4:0], tile_y[4:0] };
+        row1 <= GROUND_TILE_ROW - tile_row;
+        row_valid1 <= tile_row <= GROUND_TILE_ROW;
+        player1 <= (hcount[10:6] == 5'd3) && (vcount >= player_y_pos) &&
+                   (vcount < player_y_pos + 16);
+        { VGA_HS1, VGA_VS1, VGA_BLANK_n1 } <= { VGA_HS0, VGA_VS0, VGA_BLANK_n0 };
+    end
+
+    // The tile an obstacle shows on a level row: its own code on the ground
     always_comb begin
-        {VGA_R, VGA_G, VGA_B} = {8'h0, 8'h0, 8'h0};
-        if (VGA_BLANK_n )
-            if ( (hcount[10:6] == 5'd3) && (vcount >= player_y_pos) && (vcount < player_y_pos + 16) )
-                {VGA_R, VGA_G, VGA_B} = {8'hff, 8'hff, 8'hff};
+        tile = 4'h0;
+        if (row_valid1 && obstacle[7:4] == 4'h0)
+            if (obstacle == OBS_BLOCK_PLATFORM)
+                tile = row1 == 5'd0 ? TILE_BLOCK :
+                       row1 == 5'd1 ? TILE_PLATFORM : 4'h0;
+            else if (row1 == 5'd0)
+                tile = obstacle[3:0];
+    end
+
+    twoportbram #(.DATA_BITS(4), .ADDRESS_BITS(14),  // Tile set
+                  .INIT_FILE("obstacle_tiles.hex"))
+    tileset(.clk1  ( clk ), .clk2 ( clk ),
+            .addr1 ( { tile, y1, x1 } ),
+            .we1   ( 1'b0 ), .din1( 4'h0 ), .dout1( colorindex ),
+            .addr2 ( 14'h0 ),
+            .we2   ( 1'b0 ), .din2( 4'h0 ), .dout2( ));
+
+    always_ff @(posedge clk) begin                  // Pipeline registers
+        player2 <= player1;
+        { VGA_HS2, VGA_VS2, VGA_BLANK_n2 } <= { VGA_HS1, VGA_VS1, VGA_BLANK_n1 };
+    end
+
+    twoportbram #(.DATA_BITS(24), .ADDRESS_BITS(4),  // Palette
+                  .INIT_FILE("obstacle_palette.hex"))
+    palette(.clk1  ( clk ), .clk2 ( clk ),
+            .addr1 ( colorindex ),
+            .we1   ( 1'b0 ), .din1( 24'h0 ), .dout1( tile_rgb ),
+            .addr2 ( 4'h0 ),
+            .we2   ( 1'b0 ), .din2( 24'h0 ), .dout2( ));
+
+    always_ff @(posedge clk) begin                  // Pipeline registers
+        colorindex3 <= colorindex;
+        player3 <= player2;
+        { VGA_HS3, VGA_VS3, VGA_BLANK_n3 } <= { VGA_HS2, VGA_VS2, VGA_BLANK_n2 };
+    end
+
+    // Composite: the player over the tiles over the gradient
+    always_ff @(posedge clk) begin
+        { VGA_HS, VGA_VS, VGA_BLANK_n } <= { VGA_HS3, VGA_VS3, VGA_BLANK_n3 };
+        if (!VGA_BLANK_n3)
+            {VGA_R, VGA_G, VGA_B} <= {8'h0, 8'h0, 8'h0};
+        else if (player3)
+            {VGA_R, VGA_G, VGA_B} <= {8'hff, 8'hff, 8'hff};
+        else if (colorindex3 != 4'h0)
+            {VGA_R, VGA_G, VGA_B} <= tile_rgb;
         else
-            {VGA_R, VGA_G, VGA_B} =
-                {background_r, background_g, background_b};
+            {VGA_R, VGA_G, VGA_B} <= {gradient_r, gradient_g, gradient_b};
     end
            
 endmodule
@@ -40,6 +40,9 @@ set_fileset_property QUARTUS_SYNTH TOP_LEVEL player_sprite
 set_fileset_property QUARTUS_SYNTH ENABLE_RELATIVE_INCLUDE_PATHS false
 set_fileset_property QUARTUS_SYNTH ENABLE_FILE_OVERWRITE_MODE true
 add_fileset_file player_sprite.sv SYSTEM_VERILOG PATH player_sprite.sv TOP_LEVEL_FILE
+add_fileset_file twoportbram.sv SYSTEM_VERILOG PATH twoportbram.sv
+add_fileset_file obstacle_tiles.hex OTHER PATH obstacle_tiles.hex
+add_fileset_file obstacle_palette.hex OTHER PATH obstacle_palette.hex
 
 
 # 
@@ -118,13 +121,31 @@ set_interface_property avalon_slave_0 SVD_ADDRESS_GROUP ""
 add_interface_port avalon_slave_0 writedata writedata Input 16
 add_interface_port avalon_slave_0 write write Input 1
 add_interface_port avalon_slave_0 chipselect chipselect Input 1
-add_interface_port avalon_slave_0 address address Input 3
+add_interface_port avalon_slave_0 address address Input 4
 set_interface_assignment avalon_slave_0 embeddedsw.configuration.isFlash 0
 set_interface_assignment avalon_slave_0 embeddedsw.configuration.isMemoryDevice 0
 set_interface_assignment avalon_slave_0 embeddedsw.configuration.isNonVolatileStorage 0
 set_interface_assignment avalon_slave_0 embeddedsw.configuration.isPrintableDevice 0
 
 
+# 
+# connection point interrupt_sender
+# 
+add_interface interrupt_sender interrupt end
+set_interface_property interrupt_sender associatedAddressablePoint avalon_slave_0
+set_interface_property interrupt_sender associatedClock clock
+set_interface_property interrupt_sender associatedReset reset
+set_interface_property interrupt_sender bridgedReceiverOffset ""
+set_interface_property interrupt_sender bridgesToReceiver ""
+set_interface_property interrupt_sender ENABLED true
+set_interface_property interrupt_sender EXPORT_OF ""
+set_interface_property interrupt_sender PORT_NAME_MAP ""
+set_interface_property interrupt_sender CMSIS_SVD_VARIABLES ""
+set_interface_property interrupt_sender SVD_ADDRESS_GROUP ""
+
+add_interface_port interrupt_sender irq irq Output 1
+
+
 # 
 # connection point vga
 # 
@@ -0,0 +1,225 @@
+/*
+ * Reference model of the tiles.sv display pipeline
+ *
+ * Each scanline is done in two passes: gather the line's color indices
+ * from the tileset, one contiguous run per tile, then turn indices into
+ * RGB with a vector table lookup (SSSE3 pshufb or NEON vtbl) 16 or 8
+ * pixels at a time.  Frames of a sequence are spread over threads.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tilerender.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TR_SIMD_NEON
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define TR_SIMD_SSSE3
+#endif
+
+#define TILE_BITS 5             // 32 x 32 pixel tiles
+#define TILE_MASK 0x1F
+#define TILESET_MASK (TR_TILESET_BYTES - 1)
+
+typedef struct {                // Palette split into planes for table lookups
+  uint8_t plane[3][TR_COLORS];  // Red, green, blue
+#ifdef TR_SIMD_SSSE3
+  uint8_t interleave[3][3][16]; // pshufb masks: output block, source plane
+#endif
+} palette_planes;
+
+static void make_planes(const tr_memories *m, palette_planes *p)
+{
+  for (int i = 0; i < TR_COLORS; i++)
+    for (int c = 0; c < 3; c++)
+      p->plane[c][i] = m->palette[i][c];
+#ifdef TR_SIMD_SSSE3
+  // Output byte 16k+n of a 16-pixel group is channel (16k+n) % 3 of
+  // pixel (16k+n) / 3; 0x80 makes pshufb write zero
+  for (int k = 0; k < 3; k++)
+    for (int c = 0; c < 3; c++)
+      for (int n = 0; n < 16; n++)
+        p->interleave[k][c][n] = (16 * k + n) % 3 == c ? (16 * k + n) / 3 : 0x80;
+#endif
+}
+
+// Color indices -> packed RGB for n pixels
+static void palette_line(const palette_planes *p, const uint8_t *idx, uint8_t *rgb, size_t n)
+{
+  size_t x = 0;
+
+#if defined(TR_SIMD_SSSE3)
+  const __m128i low4 = _mm_set1_epi8(0x0F);
+  __m128i plane[3], mask[3][3];
+  for (int c = 0; c < 3; c++)
+    plane[c] = _mm_loadu_si128((const __m128i *) p->plane[c]);
+  for (int k = 0; k < 3; k++)
+    for (int c = 0; c < 3; c++)
+      mask[k][c] = _mm_loadu_si128((const __m128i *) p->interleave[k][c]);
+
+  for (; x + 16 <= n; x += 16) {
+    __m128i i = _mm_and_si128(_mm_loadu_si128((const __m128i *)(idx + x)), low4);
+    __m128i r = _mm_shuffle_epi8(plane[0], i);
+    __m128i g = _mm_shuffle_epi8(plane[1], i);
+    __m128i b = _mm_shuffle_epi8(plane[2], i);
+    for (int k = 0; k < 3; k++) {
+      __m128i out = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, mask[k][0]),
+                                              _mm_shuffle_epi8(g, mask[k][1])),
+                                 _mm_shuffle_epi8(b, mask[k][2]));
+      _mm_storeu_si128((__m128i *)(rgb + 3 * x + 16 * k), out);
+    }
+  }
+#elif defined(TR_SIMD_NEON)
+  const uint8x8_t low4 = vdup_n_u8(0x0F);
+  uint8x8x2_t plane[3];
+  for (int c = 0; c < 3; c++) {
+    plane[c].val[0] = vld1_u8(p->plane[c]);
+    plane[c].val[1] = vld1_u8(p->plane[c] + 8);
+  }
+
+  for (; x + 8 <= n; x += 8) {
+    uint8x8_t i = vand_u8(vld1_u8(idx + x), low4);
+    uint8x8x3_t out;
+    out.val[0] = vtbl2_u8(plane[0], i);
+    out.val[1] = vtbl2_u8(plane[1], i);
+    out.val[2] = vtbl2_u8(plane[2], i);
+    vst3_u8(rgb + 3 * x, out);                // Interleaves the planes
+  }
+#endif
+
+  for (rgb += 3 * x; x < n; x++, rgb += 3) {
+    uint8_t i = idx[x] & 0x0F;
+    rgb[0] = p->plane[0][i];
+    rgb[1] = p->plane[1][i];
+    rgb[2] = p->plane[2][i];
+  }
+}
+
+void tr_render_frame(const tr_memories *m, int scroll_x, int scroll_y, uint8_t *rgb)
+{
+  palette_planes p;
+  uint8_t idx[TR_HACTIVE];
+
+  make_planes(m, &p);
+
+  for (int y = 0; y < TR_VACTIVE; y++) {
+    int sy   = (y + scroll_y) & (TR_SCROLL_Y - 1);
+    int row  = sy >> TILE_BITS;                     // vcount[8:5]
+    int j    = sy & TILE_MASK;                      // vcount[4:0]
+
+    // One run per tile: the tileset holds each tile row contiguously
+    for (int x = 0; x < TR_HACTIVE; ) {
+      int sx   = (x + scroll_x) & (TR_SCROLL_X - 1);
+      int col  = sx >> TILE_BITS;                   // hcount[9:5]
+      int i    = sx & TILE_MASK;                    // hcount[4:0]
+      int t    = m->tilemap[row << 5 | col];        // Tile number
+      int base = (t << 10 | j << 5) & TILESET_MASK; // 14-bit address, as in the RTL
+      int run  = TILE_MASK + 1 - i;
+      if (run > TR_HACTIVE - x)
+        run = TR_HACTIVE - x;
+      memcpy(idx + x, m->tileset + base + i, run);
+      x += run;
+    }
+
+    palette_line(&p, idx, rgb + y * TR_HACTIVE * 3, TR_HACTIVE);
+  }
+}
+
+typedef struct {
+  const tr_memories *m;
+  int frames, dx, dy;
+  tr_frame_fn fn;
+  void *user;
+  int next;                     // Next frame to claim, shared by the workers
+} sequence_job;
+
+static void *sequence_worker(void *arg)
+{
+  sequence_job *job = (sequence_job *) arg;
+  uint8_t *rgb = (uint8_t *) malloc(TR_FRAME_BYTES);
+  int f;
+
+  if (!rgb)
+    return (void *) -1;
+  while ((f = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->frames) {
+    tr_render_frame(job->m, f * job->dx, f * job->dy, rgb);
+    job->fn(f, rgb, job->user);
+  }
+  free(rgb);
+  return NULL;
+}
+
+int tr_render_sequence(const tr_memories *m, int frames, int dx, int dy,
+                       int threads, tr_frame_fn fn, void *user)
+{
+  sequence_job job = { m, frames, dx, dy, fn, user, 0 };
+  pthread_t *tid;
+  int started = 0, failed = 0;
+
+  if (threads < 1)
+    threads = 1;
+  if (threads > frames)
+    threads = frames > 0 ? frames : 1;
+  tid = (pthread_t *) malloc(threads * sizeof(pthread_t));
+  if (!tid)
+    return -1;
+
+  for (; started < threads; started++)
+    if (pthread_create(&tid[started], NULL, sequence_worker, &job) != 0)
+      break;
+  if (started == 0)
+    failed = sequence_worker(&job) != NULL;   // No threads: render here
+  for (int i = 0; i < started; i++) {
+    void *ret;
+    pthread_join(tid[i], &ret);
+    failed |= ret != NULL;
+  }
+  free(tid);
+  return failed ? -1 : 0;
+}
+
+long tr_load_hex(const char *filename, uint8_t *dst, size_t limit)
+{
+  FILE *f = fopen(filename, "r");
+  unsigned b;
+  size_t n = 0;
+
+  if (!f)
+    return -1;
+  while (n < limit && fscanf(f, "%x", &b) == 1)
+    dst[n++] = b;
+  fclose(f);
+  return n;
+}
+
+long tr_load_binary(const char *filename, uint8_t *dst, size_t limit)
+{
+  FILE *f = fopen(filename, "rb");
+  size_t n;
+
+  if (!f)
+    return -1;
+  n = fread(dst, 1, limit, f);
+  fclose(f);
+  return n;
+}
+
+int tr_write_ppm(const char *filename, const uint8_t *rgb)
+{
+  FILE *f = filename ? fopen(filename, "wb") : stdout;
+  int ok;
+
+  if (!f)
+    return -1;
+  fprintf(f, "P6\n%d %d\n255\n", TR_HACTIVE, TR_VACTIVE);
+  ok = fwrite(rgb, 1, TR_FRAME_BYTES, f) == TR_FRAME_BYTES;
+  if (f != stdout)
+    ok &= fclose(f) == 0;
+  else
+    ok &= fflush(f) == 0;
+  return ok ? 0 : -1;
+}
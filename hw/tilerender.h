@@ -0,0 +1,60 @@
+/*
+ * Reference model of the tiles.sv display pipeline
+ *
+ * Renders exactly what the hardware shows: tilemap -> tileset -> palette,
+ * 32 x 32 pixel tiles, with the same address widths (and truncation) as
+ * the RTL.  Used by tiles2ppm and as the oracle for Verilator frame diffs.
+ */
+
+#ifndef _TILERENDER_H
+#define _TILERENDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TR_HACTIVE 640
+#define TR_VACTIVE 480
+#define TR_FRAME_BYTES (TR_HACTIVE * TR_VACTIVE * 3)  // Packed RGB
+
+#define TR_TILEMAP_BYTES 8192   // tilemap twoportbram, 13 address bits
+#define TR_TILESET_BYTES 16384  // tileset twoportbram, 14 address bits
+#define TR_COLORS 16            // palette twoportbram, 4 address bits
+
+#define TR_SCROLL_X 1024        // hcount is 10 bits: x wraps at 1024
+#define TR_SCROLL_Y 512         // vcount[8:0] addresses the tiles: y wraps at 512
+
+typedef struct {
+  uint8_t tilemap[TR_TILEMAP_BYTES];   // Tile numbers, row * 32 + column
+  uint8_t tileset[TR_TILESET_BYTES];   // Color indices, lower 4 bits used
+  uint8_t palette[TR_COLORS][3];       // Red, green, blue
+} tr_memories;
+
+// Called once per rendered frame; may run on several threads at once
+typedef void (*tr_frame_fn)(int frame, const uint8_t *rgb, void *user);
+
+// Load whitespace-separated hex bytes or a raw binary file into dst.
+// Returns bytes loaded or -1 (with errno set)
+long tr_load_hex(const char *filename, uint8_t *dst, size_t limit);
+long tr_load_binary(const char *filename, uint8_t *dst, size_t limit);
+
+// Render one 640 x 480 frame, scrolled: pixel (x, y) shows what the
+// hardware shows at ((x + scroll_x) mod 1024, (y + scroll_y) mod 512)
+void tr_render_frame(const tr_memories *m, int scroll_x, int scroll_y, uint8_t *rgb);
+
+// Render frames 0..frames-1, frame f scrolled by (f * dx, f * dy), on
+// threads workers.  Returns 0 or -1 if memory or threads ran out
+int tr_render_sequence(const tr_memories *m, int frames, int dx, int dy,
+                       int threads, tr_frame_fn fn, void *user);
+
+// Write a binary (P6) PPM of a frame; returns 0 or -1
+int tr_write_ppm(const char *filename, const uint8_t *rgb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _TILERENDER_H
@@ -1,55 +1,93 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/mman.h>
+#include "tilerender.h"
 
-#define HACTIVE 640
-#define VACTIVE 480
-#define TILE_SIZE 32  // Changed from 8 to 32
+/*
+ * Render the tile display to binary PPM files
+ *
+ * tiles2ppm [-n frames] [-x dx] [-y dy] [-j threads] [-o prefix] [-q]
+ *           <tilemap> <tileset> <palette>
+ *
+ * Memory images are raw binary, or whitespace-separated hex bytes if the
+ * name ends in .hex.  The palette is 16 entries of 4 bytes (red, green,
+ * blue, unused), the layout of the vga_tiles palette registers.
+ *
+ * One frame goes to stdout.  With -n, frame f is scrolled by (f*dx, f*dy)
+ * and written to <prefix>NNN.ppm (default "frame"); -q renders without
+ * writing, to measure throughput.
+ */
 
-typedef struct { uint8_t red, green, blue; uint8_t _padto32; } rgb_t; // 24-bit color
+typedef struct {
+  const char *prefix;   // NULL: write to stdout
+  int quiet;            // Render only
+} output_t;
 
-void *mapfile(const char *filename, size_t length)
+static void load(const char *filename, uint8_t *dst, size_t limit)
 {
-  int fd = open(filename, O_RDONLY);
-  if (fd == -1)
+  size_t len = strlen(filename);
+  long n = len > 4 && strcmp(filename + len - 4, ".hex") == 0
+    ? tr_load_hex(filename, dst, limit)
+    : tr_load_binary(filename, dst, limit);
+  if (n == -1)
     fprintf(stderr, "Error opening \"%s\": ", filename), perror(NULL), exit(1);
-  void *p = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
-  if (p == MAP_FAILED)
-    fprintf(stderr, "Error mapping \"%s\": ", filename), perror(NULL), exit(1);
-  close(fd);
-  return p;
 }
 
-int main(int argc, const char *argv[])
+static void write_frame(int frame, const uint8_t *rgb, void *user)
 {
-  if (argc != 4)
-    fprintf(stderr, "Usage: tiles2ppm <tilemap> <tileset> <palette>\n"), exit(1);
-  
-  // Update memory sizes for 32x32 tiles
-  // 640/32 = 20 columns, 480/32 = 15 rows = 300 tiles (rounded to 512)
-  uint8_t *tilemap = (uint8_t *) mapfile(argv[1], 512);
-  // 256 tiles × 32×32 × 4 bits = 131,072 bits = 16,384 bytes
-  uint8_t *tileset = (uint8_t *) mapfile(argv[2], 16384);
-  rgb_t   *palette = (rgb_t *)   mapfile(argv[3], 16 * sizeof(rgb_t));
-
-  printf("P3\n%d %d\n255\n", HACTIVE, VACTIVE); // Plain PPM header, 24 bpp
-
-  uint16_t x, y;
-  for (y = 0 ; y < VACTIVE ; y++)
-    for (x = 0 ; x < HACTIVE ; x++) {               // The tile algorithm:
-      uint8_t r     = y >> 5;                       // Row          0-14 (changed from >> 3)
-      uint8_t c     = x >> 5;                       // Column       0-19 (changed from >> 3)
-      uint8_t t     = tilemap[r << 5 | c];          // Tile number  0-255 (changed from << 7)
-      uint8_t i     = x & 0x1F;                     // Tile local x 0-31 (changed from 0x7)
-      uint8_t j     = y & 0x1F;                     // Tile local y 0-31 (changed from 0x7)
-      uint8_t color = tileset[t << 10 | j << 5 | i]; // Color        0-15 (changed from << 6 and << 3)
-      rgb_t rgb     = palette[color];               // RGB color    24 bits
-      printf("%d %d %d\n", rgb.red, rgb.green, rgb.blue);
+  const output_t *out = (const output_t *) user;
+  char filename[256];
+
+  if (out->quiet)
+    return;
+  if (out->prefix)
+    snprintf(filename, sizeof(filename), "%s%03d.ppm", out->prefix, frame);
+  if (tr_write_ppm(out->prefix ? filename : NULL, rgb) == -1)
+    fprintf(stderr, "Error writing frame %d: ", frame), perror(NULL), exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  static tr_memories m;
+  uint8_t palette[TR_COLORS * 4] = { 0 };
+  output_t out = { NULL, 0 };
+  int frames = 1, dx = 0, dy = 0;
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:x:y:j:o:q")) != -1)
+    switch (opt) {
+    case 'n': frames = atoi(optarg); if (!out.prefix) out.prefix = "frame"; break;
+    case 'x': dx = atoi(optarg); break;
+    case 'y': dy = atoi(optarg); break;
+    case 'j': threads = atoi(optarg); break;
+    case 'o': out.prefix = optarg; break;
+    case 'q': out.quiet = 1; break;
+    default:  argc = 0; break;
     }
-  
+  if (argc - optind != 3 || frames < 1)
+    fprintf(stderr, "Usage: tiles2ppm [-n frames] [-x dx] [-y dy] [-j threads] "
+            "[-o prefix] [-q] <tilemap> <tileset> <palette>\n"), exit(1);
+
+  load(argv[optind], m.tilemap, TR_TILEMAP_BYTES);
+  load(argv[optind + 1], m.tileset, TR_TILESET_BYTES);
+  load(argv[optind + 2], palette, sizeof(palette));
+  for (int i = 0; i < TR_COLORS; i++)
+    memcpy(m.palette[i], palette + 4 * i, 3);
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  if (tr_render_sequence(&m, frames, dx, dy, threads, write_frame, &out) == -1)
+    fprintf(stderr, "Rendering failed\n"), exit(1);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  if (frames > 1) {
+    double s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    fprintf(stderr, "%d frames on %d threads in %.3f s: %.1f frames/s\n",
+            frames, threads, s, frames / s);
+  }
   return 0;
 }
@@ -1,5 +1,6 @@
 module twoportbram
-  #(parameter int DATA_BITS = 8,  ADDRESS_BITS = 10)
+  #(parameter int DATA_BITS = 8,  ADDRESS_BITS = 10,
+    parameter INIT_FILE = "")      // Optional $readmemh image
    (input logic 		   clk1,  clk2,
     input logic [ADDRESS_BITS-1:0] addr1, addr2,
     input logic [DATA_BITS-1:0]    din1,  din2,
@@ -11,6 +12,9 @@ module twoportbram
    /* verilator lint_off MULTIDRIVEN */
    logic [DATA_BITS-1:0] 	   mem [WORDS-1:0];
    /* verilator lint_on MULTIDRIVEN */
+
+   initial
+     if (INIT_FILE != "") $readmemh(INIT_FILE, mem);
    
    always_ff @(posedge clk1)
      if (we1) begin
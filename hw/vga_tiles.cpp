@@ -0,0 +1,232 @@
+/*
+ * Full-frame Verilator testbench for vga_tiles.sv
+ *
+ * Loads a tilemap, tileset, and palette through the Avalon write port,
+ * clocks complete 800 x 525 frames, and writes the 640 x 480 visible part
+ * of each one to a binary PPM (frame000.ppm, ...) from VGA_R/G/B, taking
+ * only pixels with VGA_BLANK_n high.  Reports simulated frames per second.
+ *
+ * Usage: Vvga_tiles [-n frames] [-o prefix] [-p palette] [-q] [-c]
+ *                   [tilemap.hex [tileset.hex]]
+ *
+ * .hex files are whitespace-separated hex bytes, as in tilemap1.hex.
+ * A palette file is 16 lines of RRGGBB; without one, a fixed 16-color
+ * palette is used.  -q skips writing images (for benchmarking).
+ *
+ * -c compares every frame against the tilerender.c reference model and
+ * exits with status 1 if any pixel differs.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <verilated.h>
+#include <Vvga_tiles.h>
+#include "tilerender.h"
+
+#define HACTIVE 640
+#define VACTIVE 480
+#define HTOTAL 800
+#define VTOTAL 525
+
+#define TILEMAP_BASE 0x0000         // Avalon byte addresses, see vga_tiles.sv
+#define TILEMAP_BYTES 0x2000
+#define PALETTE_BASE 0x2000
+#define PALETTE_COLORS 16
+#define TILESET_BASE 0x4000
+#define TILESET_BYTES 0x4000
+
+static const uint32_t default_palette[PALETTE_COLORS] = {
+  0x000000, 0xffffff, 0x0080ff, 0xff4000, 0x00c040, 0xffd000, 0x8000ff, 0x00e0e0,
+  0x404040, 0x808080, 0xc0c0c0, 0x800000, 0x008000, 0x000080, 0xff80c0, 0x604020
+};
+
+// One cycle of both clocks; the Avalon and VGA clocks share an edge here
+static void tick(Vvga_tiles *dut) {
+  dut->clk = dut->vga_clk_in = 0;
+  dut->eval();
+  dut->clk = dut->vga_clk_in = 1;
+  dut->eval();
+}
+
+// A single-cycle Avalon write, as the HPS bridge would issue it
+static void avalon_write(Vvga_tiles *dut, unsigned address, uint8_t data) {
+  dut->chipselect = 1;
+  dut->write = 1;
+  dut->address = address;
+  dut->writedata = data;
+  tick(dut);
+  dut->chipselect = 0;
+  dut->write = 0;
+}
+
+static std::vector<uint8_t> read_hex(const char *filename, size_t limit) {
+  std::vector<uint8_t> bytes;
+  FILE *f = fopen(filename, "r");
+  unsigned b;
+
+  if (!f) {
+    fprintf(stderr, "Error opening \"%s\": ", filename);
+    perror(NULL);
+    exit(1);
+  }
+  while (bytes.size() < limit && fscanf(f, "%x", &b) == 1)
+    bytes.push_back(b);
+  fclose(f);
+  return bytes;
+}
+
+static void read_palette(const char *filename, uint32_t *palette) {
+  FILE *f = fopen(filename, "r");
+
+  if (!f) {
+    fprintf(stderr, "Error opening \"%s\": ", filename);
+    perror(NULL);
+    exit(1);
+  }
+  for (int i = 0; i < PALETTE_COLORS; i++)
+    if (fscanf(f, "%x", &palette[i]) != 1) {
+      fprintf(stderr, "%s: expected %d colors\n", filename, PALETTE_COLORS);
+      exit(1);
+    }
+  fclose(f);
+}
+
+static void write_ppm(const std::string &filename, const std::vector<uint8_t> &rgb) {
+  FILE *f = fopen(filename.c_str(), "wb");
+
+  if (!f) {
+    fprintf(stderr, "Error creating \"%s\": ", filename.c_str());
+    perror(NULL);
+    exit(1);
+  }
+  fprintf(f, "P6\n%d %d\n255\n", HACTIVE, VACTIVE);
+  fwrite(rgb.data(), 1, rgb.size(), f);
+  fclose(f);
+}
+
+int main(int argc, char **argv) {
+  int frames = 1;
+  std::string prefix = "frame";
+  const char *palette_file = NULL;
+  bool quiet = false;
+  bool compare = false;
+  int opt;
+
+  Verilated::commandArgs(argc, argv);
+
+  while ((opt = getopt(argc, argv, "n:o:p:qc")) != -1)
+    switch (opt) {
+    case 'n': frames = atoi(optarg); break;
+    case 'o': prefix = optarg; break;
+    case 'p': palette_file = optarg; break;
+    case 'q': quiet = true; break;
+    case 'c': compare = true; break;
+    default:
+      fprintf(stderr, "Usage: %s [-n frames] [-o prefix] [-p palette] [-q] [-c] "
+              "[tilemap.hex [tileset.hex]]\n", argv[0]);
+      return 1;
+    }
+  const char *tilemap_file = optind < argc ? argv[optind] : "tilemap1.hex";
+  const char *tileset_file = optind + 1 < argc ? argv[optind + 1] : "tileset1.hex";
+
+  uint32_t palette[PALETTE_COLORS];
+  memcpy(palette, default_palette, sizeof(palette));
+  if (palette_file)
+    read_palette(palette_file, palette);
+  std::vector<uint8_t> tilemap = read_hex(tilemap_file, TILEMAP_BYTES);
+  std::vector<uint8_t> tileset = read_hex(tileset_file, TILESET_BYTES);
+
+  // The same memory contents, for the reference model
+  static tr_memories golden;
+  std::vector<uint8_t> expected(TR_FRAME_BYTES);
+  long long mismatches = 0;
+  if (compare) {
+    memcpy(golden.tilemap, tilemap.data(), tilemap.size());
+    memcpy(golden.tileset, tileset.data(), tileset.size());
+    for (int i = 0; i < PALETTE_COLORS; i++) {
+      golden.palette[i][0] = palette[i] >> 16;
+      golden.palette[i][1] = palette[i] >> 8;
+      golden.palette[i][2] = palette[i];
+    }
+    tr_render_frame(&golden, 0, 0, expected.data());
+  }
+
+  Vvga_tiles *dut = new Vvga_tiles;
+
+  // Hold both sides in reset for a few cycles
+  dut->reset = 1;
+  dut->VGA_RESET = 1;
+  dut->chipselect = 0;
+  dut->write = 0;
+  for (int i = 0; i < 4; i++)
+    tick(dut);
+  dut->reset = 0;
+
+  // Load memories through the bus port, with the display still in reset
+  for (size_t i = 0; i < tilemap.size(); i++)
+    avalon_write(dut, TILEMAP_BASE + i, tilemap[i]);
+  for (size_t i = 0; i < tileset.size(); i++)
+    avalon_write(dut, TILESET_BASE + i, tileset[i]);
+  for (int i = 0; i < PALETTE_COLORS; i++) {
+    avalon_write(dut, PALETTE_BASE + 4 * i + 0, palette[i] >> 16);      // Red
+    avalon_write(dut, PALETTE_BASE + 4 * i + 1, palette[i] >> 8);       // Green
+    avalon_write(dut, PALETTE_BASE + 4 * i + 2, palette[i]);            // Blue
+    avalon_write(dut, PALETTE_BASE + 4 * i + 3, 0);                     // Commit
+  }
+  dut->VGA_RESET = 0;
+
+  // Collect visible pixels in scan order; a frame is complete once
+  // HACTIVE * VACTIVE of them have gone by
+  std::vector<uint8_t> rgb(HACTIVE * VACTIVE * 3);
+  size_t pixel = 0;
+  long long cycles = 0;
+  int frame = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  while (frame < frames) {
+    tick(dut);
+    cycles++;
+    if (!dut->VGA_BLANK_n)
+      continue;
+    rgb[3 * pixel + 0] = dut->VGA_R;
+    rgb[3 * pixel + 1] = dut->VGA_G;
+    rgb[3 * pixel + 2] = dut->VGA_B;
+    if (++pixel == HACTIVE * VACTIVE) {
+      if (compare)
+        for (size_t p = 0; p < HACTIVE * VACTIVE; p++)
+          if (memcmp(&rgb[3 * p], &expected[3 * p], 3) != 0 && mismatches++ == 0)
+            fprintf(stderr, "frame %d: first mismatch at (%zu, %zu): "
+                    "RTL %02x%02x%02x, model %02x%02x%02x\n", frame,
+                    p % HACTIVE, p / HACTIVE, rgb[3 * p], rgb[3 * p + 1],
+                    rgb[3 * p + 2], expected[3 * p], expected[3 * p + 1],
+                    expected[3 * p + 2]);
+      if (!quiet) {
+        char name[16];
+        snprintf(name, sizeof(name), "%03d.ppm", frame);
+        write_ppm(prefix + name, rgb);
+      }
+      pixel = 0;
+      frame++;
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  printf("%d frames, %lld cycles (%lld per frame, expected %d) in %.2f s\n",
+         frames, cycles, cycles / frames, HTOTAL * VTOTAL, seconds);
+  printf("%.2f simulated frames/s (%.3f%% of real time at 60 Hz)\n",
+         frames / seconds, frames / seconds / 60.0 * 100.0);
+
+  if (compare)
+    printf("%lld pixels differ from the reference model\n", mismatches);
+
+  dut->final();
+  delete dut;
+
+  return mismatches ? 1 : 0;
+}
@@ -1,15 +1,18 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
 
 #include "audio_fifo.h"
+#include "audio_source.h"
 
 
 #define I2C_DEV "/dev/i2c-0"  // Might be /dev/i2c-1 on some boards
 #define WM8731_ADDR 0x1A
+#define BLOCK_FRAMES 4096     // Stereo frames read and written per block
 
 // Utility to send a 9-bit register: 7 bits address + 9 bits data
 int wm8731_write(int i2c_fd, uint8_t reg, uint16_t data) {
@@ -88,67 +91,29 @@ int main() {
         return 1;
     }
 
-    FILE *audio = fopen("monody_stereo_48k.raw", "rb");
-    if (!audio) {
+    AudioSource audio;
+    if (audio_source_open(&audio, "monody_stereo_48k.raw") == -1) {
         perror("Failed to open audio file");
         close(fd);
         return 1;
     }
 
     printf("Opened audio_fifo device and audio file\n");
-    audio_fifo_arg_t arg = {0};
-    uint16_t dummy;
-	
-
-	//uint32_t fill_level;
-	//if (ioctl(fd, READ_AUDIO_FILL_LEVEL, &fill_level) == -1) {
-	//	perror("ioctl READ_AUDIO_FILL_LEVEL failed");
-	//	close(fd);
-	//	return 1;
-	//}
-
-	//printf("Initial FIFO fill level: %u\n", fill_level);
-
-	int i = 0;
-    while (fread(&arg.audio, sizeof(uint16_t), 1, audio) == 1) {
-		// printf("Skipping right channel\n");
-        // Skip right channel
-        fread(&dummy, sizeof(uint16_t), 1, audio);  // skip right
-
-		// Shift left sample into upper 16 bits, right = 0
-		arg.audio = (uint32_t)arg.audio;
-
-		if (ioctl(fd, WRITE_AUDIO_FIFO, &arg) == -1) {
-			perror("ioctl WRITE_AUDIO_FIFO failed");
+
+	// Convert straight out of the mapped file, downmixed to one FIFO word
+	// per frame, and hand the driver one block per write()
+	uint32_t words[BLOCK_FRAMES];
+	size_t n;
+
+	while ((n = audio_source_read(&audio, words, BLOCK_FRAMES, GAIN_UNITY)) > 0) {
+		if (audio_write_all(fd, words, n) == -1) {
+			perror("write to audio_fifo failed");
 			break;
 		}
-	/*	
-		uint32_t status;
-		if ((i++ % 1000) == 0) {
-			
-      if (ioctl(fd, READ_AUDIO_STATUS, &status) == -1) {
-				perror("ioctl READ_AUDIO_STATUS failed");
-				close(fd);
-				return 1;
-			} else {
-				print_fifo_status(status);
-			}
-
-			uint32_t fill_level;
-			if (ioctl(fd, READ_AUDIO_FILL_LEVEL, &fill_level) == -1) {
-				perror("ioctl READ_AUDIO_FILL_LEVEL failed");
-				close(fd);
-				return 1;
-			}
-
-			printf("FIFO fill level: %u\n", fill_level);
-		}
-*/
-		usleep(100);
-    }
+	}
 
     printf("cleaning up\n");
-    fclose(audio);
+    audio_source_close(&audio);
     close(fd);
     return 0;
 }
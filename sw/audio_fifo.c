@@ -13,7 +13,21 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/ioctl.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/kfifo.h>
+#include <linux/interrupt.h>
+#include <linux/of_irq.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/device.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
 #include "audio_fifo.h"
+#include "driver_stats.h"
+
+#define CREATE_TRACE_POINTS
+#include "audio_fifo_trace.h"
 
 // ===============================================
 // ===== audio_fifo structures and constants =====
@@ -21,6 +35,17 @@
 
 #define AUDIO_FIFO_NAME "audio_fifo"
 #define FIFO_ISTATUS_OFFSET    0x4 // relative to CSR base
+#define FIFO_EVENT_OFFSET      0x8 // sticky status bits, write 1 to clear
+#define FIFO_IENABLE_OFFSET    0xC // which event bits raise in_irq
+#define FIFO_ALMOSTFULL_OFFSET  0x10
+#define FIFO_ALMOSTEMPTY_OFFSET 0x14
+
+#define FIFO_ALMOSTEMPTY_BIT   (1 << 3)
+#define FIFO_OVERFLOW_BIT      (1 << 4)
+#define FIFO_UNDERFLOW_BIT     (1 << 5)
+#define AUDIO_RING_BYTES       (64 * 1024)          // Kernel-side sample buffer
+#define AUDIO_REFILL_LEVEL     (AUDIO_FIFO_DEPTH / 4) // Refill at or below this
+#define AUDIO_POLL_NS          (2 * NSEC_PER_MSEC)  // Refill period without the IRQ
 
 struct audio_fifo_dev {
     struct resource res;
@@ -28,11 +53,41 @@ struct audio_fifo_dev {
     struct resource res_csr;
     void __iomem *virtbase;
 	void __iomem *virtbase_csr;
+	int irq;                        /* FIFO in_irq (almost empty), 0 if none */
+	struct hrtimer poll_timer;      /* Refills in its place when there is none */
+	DECLARE_KFIFO_PTR(ring, u32);   /* Samples written but not yet in the FIFO */
+	struct mutex write_lock;        /* Serializes producers into the ring */
+	spinlock_t refill_lock;         /* Serializes the ring -> FIFO consumer */
+	wait_queue_head_t space_wait;   /* Writers waiting for ring space */
+	u32 bounce[AUDIO_FIFO_DEPTH];   /* Samples on their way to the FIFO */
+	bool streaming;                 /* Last refill fed the FIFO or left samples queued */
+	audio_fifo_stats_t stats;       /* Telemetry, under refill_lock */
+	struct dentry *debugfs;         /* Our directory under debugfs */
 } audio_dev;
 
-static void write_audio_fifo(uint32_t sample) {
-    iowrite32(sample, audio_dev.virtbase);
-}
+/*
+Call counts and timings for debugfs: one slot per ioctl number, plus the
+bulk write() path and the ring -> FIFO refill, which is where the MMIO
+time of a stream goes.
+*/
+#define STAT_WRITE  7
+#define STAT_REFILL 8
+
+static struct drv_cmd_stats audio_cmd_stats[] = {
+	[_IOC_NR(WRITE_AUDIO_FIFO)]      = { .name = "WRITE_AUDIO_FIFO" },
+	[_IOC_NR(READ_AUDIO_FILL_LEVEL)] = { .name = "READ_AUDIO_FILL_LEVEL" },
+	[_IOC_NR(READ_AUDIO_STATUS)]     = { .name = "READ_AUDIO_STATUS" },
+	[_IOC_NR(READ_AUDIO_QUEUED)]     = { .name = "READ_AUDIO_QUEUED" },
+	[_IOC_NR(READ_AUDIO_STATS)]      = { .name = "READ_AUDIO_STATS" },
+	[_IOC_NR(RESET_AUDIO_STATS)]     = { .name = "RESET_AUDIO_STATS" },
+	[STAT_WRITE]                     = { .name = "write" },
+	[STAT_REFILL]                    = { .name = "refill" },
+};
+
+static struct drv_stats audio_stats = {
+	.cmds = audio_cmd_stats,
+	.count = ARRAY_SIZE(audio_cmd_stats),
+};
 
 static uint32_t read_fifo_fill_level(void) {
     return ioread32(audio_dev.virtbase_csr);
@@ -42,25 +97,208 @@ static uint32_t read_fifo_status(void) {
     return ioread32(audio_dev.virtbase_csr + FIFO_ISTATUS_OFFSET) & 0x3F; // Only i_status bits
 }
 
-static long audio_fifo_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
+/* Called with refill_lock held */
+static void reset_stats(void)
+{
+	memset(&audio_dev.stats, 0, sizeof(audio_dev.stats));
+	audio_dev.stats.min_fill = AUDIO_FIFO_DEPTH;
+}
+
+/* Count and clear the sticky overflow/underflow events; refill_lock held */
+static void count_events(void)
+{
+	u32 event = ioread32(audio_dev.virtbase_csr + FIFO_EVENT_OFFSET) &
+		    (FIFO_OVERFLOW_BIT | FIFO_UNDERFLOW_BIT);
+
+	if (!event)
+		return;
+	if (event & FIFO_OVERFLOW_BIT)
+		audio_dev.stats.overflows++;
+	if (event & FIFO_UNDERFLOW_BIT)
+		audio_dev.stats.underflows++;
+	iowrite32(event, audio_dev.virtbase_csr + FIFO_EVENT_OFFSET);
+}
+
+/* Record the fill level if a stream is playing; refill_lock held */
+static void record_fill(u32 level)
+{
+	audio_fifo_stats_t *st = &audio_dev.stats;
+
+	if (!audio_dev.streaming)
+		return;
+	if (level < st->min_fill)
+		st->min_fill = level;
+	st->fill_samples++;
+	st->fill_histogram[min_t(u32, level / (AUDIO_FIFO_DEPTH / AUDIO_FILL_BUCKETS),
+				 AUDIO_FILL_BUCKETS - 1)]++;
+}
+
+/*
+Move as much of the ring as fits into the hardware FIFO.  The almost-empty
+interrupt stays enabled only while the ring still has samples to give.
+Called with refill_lock held.
+*/
+static void refill_fifo(void)
+{
+	u64 start = ktime_get_ns();
+	u32 level = read_fifo_fill_level();
+	u32 space = level >= AUDIO_FIFO_DEPTH ? 0 : AUDIO_FIFO_DEPTH - level;
+	unsigned int n = 0;
+
+	count_events();
+	record_fill(level);
+
+	if (space) {
+		n = kfifo_out(&audio_dev.ring, audio_dev.bounce, space);
+		if (n) {
+			iowrite32_rep(audio_dev.virtbase, audio_dev.bounce, n);
+			audio_dev.stats.samples_written += n;
+		}
+	}
+
+	audio_dev.streaming = n || !kfifo_is_empty(&audio_dev.ring);
+	iowrite32(kfifo_is_empty(&audio_dev.ring) ? 0 : FIFO_ALMOSTEMPTY_BIT,
+		  audio_dev.virtbase_csr + FIFO_IENABLE_OFFSET);
+
+	drv_stats_record(&audio_cmd_stats[STAT_REFILL], ktime_get_ns() - start);
+	trace_audio_fifo_refill(level, n, kfifo_len(&audio_dev.ring));
+}
+
+static void kick_refill(void)
+{
+	unsigned long flags;
+	bool queued;
+
+	spin_lock_irqsave(&audio_dev.refill_lock, flags);
+	refill_fifo();
+	queued = !kfifo_is_empty(&audio_dev.ring);
+	spin_unlock_irqrestore(&audio_dev.refill_lock, flags);
+
+	// Without the almost-empty IRQ, poll until the ring drains
+	if (!audio_dev.irq && queued && !hrtimer_is_queued(&audio_dev.poll_timer))
+		hrtimer_start(&audio_dev.poll_timer, ns_to_ktime(AUDIO_POLL_NS),
+			      HRTIMER_MODE_REL);
+}
+
+/*
+Polled refill for device trees without the FIFO's interrupt.  The FIFO
+holds over 10 ms of audio, so a refill every AUDIO_POLL_NS keeps it fed.
+*/
+static enum hrtimer_restart audio_fifo_poll_refill(struct hrtimer *timer)
+{
+	unsigned long flags;
+	bool queued;
+
+	spin_lock_irqsave(&audio_dev.refill_lock, flags);
+	refill_fifo();
+	queued = !kfifo_is_empty(&audio_dev.ring);
+	spin_unlock_irqrestore(&audio_dev.refill_lock, flags);
+
+	wake_up_interruptible(&audio_dev.space_wait);
+	if (!queued)
+		return HRTIMER_NORESTART;
+	hrtimer_forward_now(timer, ns_to_ktime(AUDIO_POLL_NS));
+	return HRTIMER_RESTART;
+}
+
+static irqreturn_t audio_fifo_irq(int irq, void *dev_id)
+{
+	u32 event = ioread32(audio_dev.virtbase_csr + FIFO_EVENT_OFFSET);
+
+	if (!(event & FIFO_ALMOSTEMPTY_BIT))
+		return IRQ_NONE;
+
+	spin_lock(&audio_dev.refill_lock);
+	refill_fifo();
+	iowrite32(FIFO_ALMOSTEMPTY_BIT, audio_dev.virtbase_csr + FIFO_EVENT_OFFSET);
+	spin_unlock(&audio_dev.refill_lock);
+
+	wake_up_interruptible(&audio_dev.space_wait);
+	return IRQ_HANDLED;
+}
+
+/*
+Queue the user's packed samples in the ring and start the FIFO refilling.
+Returns the bytes accepted; short writes are normal.  Blocks while the
+ring is full unless O_NONBLOCK; the almost-empty interrupt drains it.
+*/
+static ssize_t audio_fifo_write(struct file *f, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	u64 start = ktime_get_ns();
+	unsigned int copied;
+	ssize_t ret;
+
+	if (count < sizeof(u32))
+		return -EINVAL;
+	if (mutex_lock_interruptible(&audio_dev.write_lock))
+		return -ERESTARTSYS;
+
+	while (kfifo_is_full(&audio_dev.ring)) {
+		if (f->f_flags & O_NONBLOCK) {
+			ret = -EAGAIN;
+			goto out;
+		}
+		if (wait_event_interruptible(audio_dev.space_wait,
+					     !kfifo_is_full(&audio_dev.ring))) {
+			ret = -ERESTARTSYS;
+			goto out;
+		}
+	}
+
+	ret = kfifo_from_user(&audio_dev.ring, buf, count & ~(sizeof(u32) - 1), &copied);
+	if (ret == 0)
+		ret = copied;
+	kick_refill();
+
+out:
+	mutex_unlock(&audio_dev.write_lock);
+	drv_stats_record(&audio_cmd_stats[STAT_WRITE], ktime_get_ns() - start);
+	return ret;
+}
+
+static __poll_t audio_fifo_poll(struct file *f, poll_table *wait)
+{
+	poll_wait(f, &audio_dev.space_wait, wait);
+	if (!kfifo_is_full(&audio_dev.ring))
+		return EPOLLOUT | EPOLLWRNORM;
+	return 0;
+}
+
+/* Snapshot the counters, picking up any events since the last refill */
+static void read_stats(audio_fifo_stats_t *stats)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&audio_dev.refill_lock, flags);
+	count_events();
+	*stats = audio_dev.stats;
+	spin_unlock_irqrestore(&audio_dev.refill_lock, flags);
+}
+
+static long audio_fifo_do_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 {
-    printk(KERN_INFO "audio_fifo_ioctl called with cmd 0x%x\n", cmd);
 	if (!audio_dev.virtbase) {
 		pr_err("audio_fifo_ioctl: virtbase is NULL\n");
 		return -EIO;
 	}
     switch (cmd) {
 		case WRITE_AUDIO_FIFO: {
-      printk(KERN_INFO "WRITE_AUDIO_FIFO");
 			audio_fifo_arg_t vla;
+			int queued;
 			if (copy_from_user(&vla, (audio_fifo_arg_t __user *)arg, sizeof(vla)))
 				return -EFAULT;
-			write_audio_fifo(vla.audio);
+			/* Single samples queue behind any bulk writes */
+			mutex_lock(&audio_dev.write_lock);
+			queued = kfifo_put(&audio_dev.ring, vla.audio);
+			mutex_unlock(&audio_dev.write_lock);
+			if (!queued)
+				return -EAGAIN;
+			kick_refill();
 			break;
 		}
 	
 		case READ_AUDIO_STATUS: {
-      printk(KERN_INFO "READ_AUDIO_STATUS");
 			uint32_t status = read_fifo_status();
 			if (copy_to_user((uint32_t __user *)arg, &status, sizeof(status)))
 				return -EFAULT;
@@ -68,13 +306,35 @@ static long audio_fifo_ioctl(struct file *f, unsigned int cmd, unsigned long arg
 		}
 	
 		case READ_AUDIO_FILL_LEVEL: {
-      printk(KERN_INFO "READ_AUDIO_FILL_LEVEL");
 			uint32_t level = read_fifo_fill_level();
 			if (copy_to_user((uint32_t __user *)arg, &level, sizeof(level)))
 				return -EFAULT;
 			break;
 		}
 	
+		case READ_AUDIO_QUEUED: {
+			uint32_t queued = kfifo_len(&audio_dev.ring) + read_fifo_fill_level();
+			if (copy_to_user((uint32_t __user *)arg, &queued, sizeof(queued)))
+				return -EFAULT;
+			break;
+		}
+	
+		case READ_AUDIO_STATS: {
+			audio_fifo_stats_t stats;
+			read_stats(&stats);
+			if (copy_to_user((audio_fifo_stats_t __user *)arg, &stats, sizeof(stats)))
+				return -EFAULT;
+			break;
+		}
+	
+		case RESET_AUDIO_STATS: {
+			unsigned long flags;
+			spin_lock_irqsave(&audio_dev.refill_lock, flags);
+			reset_stats();
+			spin_unlock_irqrestore(&audio_dev.refill_lock, flags);
+			break;
+		}
+	
 		default:
 			return -EINVAL;
 	}
@@ -82,16 +342,91 @@ static long audio_fifo_ioctl(struct file *f, unsigned int cmd, unsigned long arg
     return 0;
 }
 
+/* Time every ioctl for the debugfs stats and the audio_fifo_ioctl tracepoint */
+static long audio_fifo_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
+{
+	u64 start = ktime_get_ns();
+	long ret = audio_fifo_do_ioctl(f, cmd, arg);
+	u64 ns = ktime_get_ns() - start;
+
+	if (_IOC_TYPE(cmd) == AUDIO_FIFO_MAGIC && _IOC_NR(cmd) < STAT_WRITE)
+		drv_stats_record(&audio_cmd_stats[_IOC_NR(cmd)], ns);
+	trace_audio_fifo_ioctl(cmd, ret, ns);
+	return ret;
+}
+
 
 static const struct file_operations audio_fifo_fops = {
     .owner = THIS_MODULE,
+    .write = audio_fifo_write,
+    .poll = audio_fifo_poll,
     .unlocked_ioctl = audio_fifo_ioctl
 };
 
+/*
+The same counters under /sys/class/misc/audio_fifo/ for scripts and
+logging.  Writing anything to "reset" clears them.
+*/
+#define STATS_ATTR(field, fmt)						\
+static ssize_t field##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	audio_fifo_stats_t stats;					\
+	read_stats(&stats);						\
+	return sysfs_emit(buf, fmt "\n", stats.field);			\
+}									\
+static DEVICE_ATTR_RO(field)
+
+STATS_ATTR(samples_written, "%llu");
+STATS_ATTR(underflows, "%u");
+STATS_ATTR(overflows, "%u");
+STATS_ATTR(min_fill, "%u");
+STATS_ATTR(fill_samples, "%u");
+
+static ssize_t fill_histogram_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	audio_fifo_stats_t stats;
+	int len = 0;
+	int i;
+
+	read_stats(&stats);
+	for (i = 0; i < AUDIO_FILL_BUCKETS; i++)
+		len += sysfs_emit_at(buf, len, "%u%c", stats.fill_histogram[i],
+				     i == AUDIO_FILL_BUCKETS - 1 ? '\n' : ' ');
+	return len;
+}
+static DEVICE_ATTR_RO(fill_histogram);
+
+static ssize_t reset_store(struct device *dev, struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&audio_dev.refill_lock, flags);
+	reset_stats();
+	spin_unlock_irqrestore(&audio_dev.refill_lock, flags);
+	return count;
+}
+static DEVICE_ATTR_WO(reset);
+
+static struct attribute *audio_fifo_attrs[] = {
+	&dev_attr_samples_written.attr,
+	&dev_attr_underflows.attr,
+	&dev_attr_overflows.attr,
+	&dev_attr_min_fill.attr,
+	&dev_attr_fill_samples.attr,
+	&dev_attr_fill_histogram.attr,
+	&dev_attr_reset.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(audio_fifo);
+
 static struct miscdevice audio_fifo_misc_device = {
     .minor = MISC_DYNAMIC_MINOR,
     .name = AUDIO_FIFO_NAME,
-    .fops = &audio_fifo_fops
+    .fops = &audio_fifo_fops,
+    .groups = audio_fifo_groups,
 };
 
 static int __init audio_fifo_probe(struct platform_device *pdev) {
@@ -99,10 +434,14 @@ static int __init audio_fifo_probe(struct platform_device *pdev) {
 
     pr_info("audio_fifo: probe started\n");
 
-    // Register misc device
-    ret = misc_register(&audio_fifo_misc_device);
+    mutex_init(&audio_dev.write_lock);
+    spin_lock_init(&audio_dev.refill_lock);
+    init_waitqueue_head(&audio_dev.space_wait);
+    reset_stats();
+
+    ret = kfifo_alloc(&audio_dev.ring, AUDIO_RING_BYTES / sizeof(u32), GFP_KERNEL);
     if (ret) {
-        pr_err("audio_fifo: failed to register misc device\n");
+        pr_err("audio_fifo: failed to allocate ring buffer\n");
         return ret;
     }
 
@@ -110,11 +449,11 @@ static int __init audio_fifo_probe(struct platform_device *pdev) {
     ret = of_address_to_resource(pdev->dev.of_node, 0, &audio_dev.res_fifo);
     if (ret) {
         pr_err("audio_fifo: failed to get FIFO resource\n");
-        goto out_deregister;
+        goto out_free_ring;
     }
     if (!request_mem_region(audio_dev.res_fifo.start, resource_size(&audio_dev.res_fifo), AUDIO_FIFO_NAME)) {
         ret = -EBUSY;
-        goto out_deregister;
+        goto out_free_ring;
     }
 
     // Get CSR memory resource
@@ -144,29 +483,74 @@ static int __init audio_fifo_probe(struct platform_device *pdev) {
         goto out_unmap_fifo;
     }
 
+    // Refill from the ring whenever the FIFO runs almost empty
+    iowrite32(0, audio_dev.virtbase_csr + FIFO_IENABLE_OFFSET);
+    iowrite32(AUDIO_REFILL_LEVEL, audio_dev.virtbase_csr + FIFO_ALMOSTEMPTY_OFFSET);
+    iowrite32(0x3F, audio_dev.virtbase_csr + FIFO_EVENT_OFFSET);
+
+    hrtimer_init(&audio_dev.poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    audio_dev.poll_timer.function = audio_fifo_poll_refill;
+
+    audio_dev.irq = irq_of_parse_and_map(pdev->dev.of_node, 0);
+    if (!audio_dev.irq) {
+        pr_warn("audio_fifo: no interrupt in the device tree, polling the FIFO\n");
+    } else {
+        ret = request_irq(audio_dev.irq, audio_fifo_irq, 0, AUDIO_FIFO_NAME, &audio_dev);
+        if (ret) {
+            pr_err("audio_fifo: failed to request IRQ %d\n", audio_dev.irq);
+            goto out_dispose_irq;
+        }
+    }
+
+    // Register the misc device last: write() and ioctl() may run as soon
+    // as it exists, and they need the mappings and the IRQ
+    ret = misc_register(&audio_fifo_misc_device);
+    if (ret) {
+        pr_err("audio_fifo: failed to register misc device\n");
+        goto out_free_irq;
+    }
+
+    audio_dev.debugfs = drv_stats_debugfs(AUDIO_FIFO_NAME, &audio_stats);
+
     pr_info("audio_fifo: probe successful\n");
     pr_info("audio_fifo: FIFO mapped to %p, CSR mapped to %p\n", audio_dev.virtbase, audio_dev.virtbase_csr);
     return 0;
 
 // Cleanup paths
+out_free_irq:
+    if (audio_dev.irq)
+        free_irq(audio_dev.irq, &audio_dev);
+out_dispose_irq:
+    if (audio_dev.irq)
+        irq_dispose_mapping(audio_dev.irq);
+    iounmap(audio_dev.virtbase_csr);
 out_unmap_fifo:
     iounmap(audio_dev.virtbase);
 out_release_csr:
     release_mem_region(audio_dev.res_csr.start, resource_size(&audio_dev.res_csr));
 out_release_fifo:
     release_mem_region(audio_dev.res_fifo.start, resource_size(&audio_dev.res_fifo));
-out_deregister:
-    misc_deregister(&audio_fifo_misc_device);
+out_free_ring:
+    kfifo_free(&audio_dev.ring);
     return ret;
 }
 
 
 static int __exit audio_fifo_remove(struct platform_device *pdev) {
+	// Mirror probe: no new write() or ioctl() once the mappings go
+	misc_deregister(&audio_fifo_misc_device);
+	debugfs_remove_recursive(audio_dev.debugfs);
+	iowrite32(0, audio_dev.virtbase_csr + FIFO_IENABLE_OFFSET);
+	if (audio_dev.irq) {
+		free_irq(audio_dev.irq, &audio_dev);
+		irq_dispose_mapping(audio_dev.irq);
+	}
+	hrtimer_cancel(&audio_dev.poll_timer);
 	iounmap(audio_dev.virtbase);
 	iounmap(audio_dev.virtbase_csr);
 	release_mem_region(audio_dev.res_fifo.start, resource_size(&audio_dev.res_fifo));
 	release_mem_region(audio_dev.res_csr.start, resource_size(&audio_dev.res_csr));
-	misc_deregister(&audio_fifo_misc_device);
+	kfifo_free(&audio_dev.ring);
     pr_info("audio_fifo: removed\n");
     return 0;
 }
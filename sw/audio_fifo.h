@@ -11,9 +11,34 @@ typedef struct {
     uint32_t audio; // or any structure matching what audio_fifo_ioctl expects
 } audio_fifo_arg_t;
 
+#define AUDIO_FIFO_DEPTH 512   // Words the hardware FIFO holds
+
+#define AUDIO_FILL_BUCKETS 16  // Fill-level histogram buckets, AUDIO_FIFO_DEPTH / 16 words each
+
+// Running counters since load or the last RESET_AUDIO_STATS.  Fill levels
+// are sampled each time the driver tops up the FIFO while a stream is
+// playing, so min_fill is how close playback came to running dry.
+typedef struct {
+    uint64_t samples_written;      // Words moved into the hardware FIFO
+    uint32_t underflows;           // UNDERFLOW events (codec found the FIFO empty)
+    uint32_t overflows;            // OVERFLOW events (write to a full FIFO)
+    uint32_t min_fill;             // Lowest fill level sampled
+    uint32_t fill_samples;         // Fill levels sampled
+    uint32_t fill_histogram[AUDIO_FILL_BUCKETS];
+} audio_fifo_stats_t;
+
+// FIFO word for one frame.  The FIFO feeds only the codec's 32-bit
+// left-channel sink, which plays the upper half; the lower half would land
+// in its LSBs as noise, so frames go out mono with it clear
+#define AUDIO_FIFO_WORD(sample) ((uint32_t)(uint16_t)(sample) << 16)
+
+// write() takes a buffer of 32-bit FIFO words, one per frame
 #define AUDIO_FIFO_MAGIC 'r'
 #define WRITE_AUDIO_FIFO       _IOW(AUDIO_FIFO_MAGIC, 1, audio_fifo_arg_t *)
 #define READ_AUDIO_FILL_LEVEL  _IOR(AUDIO_FIFO_MAGIC, 2, uint32_t *)
 #define READ_AUDIO_STATUS      _IOR(AUDIO_FIFO_MAGIC, 3, uint32_t *)
+#define READ_AUDIO_QUEUED      _IOR(AUDIO_FIFO_MAGIC, 4, uint32_t *) // Ring + FIFO words not yet played
+#define READ_AUDIO_STATS       _IOR(AUDIO_FIFO_MAGIC, 5, audio_fifo_stats_t *)
+#define RESET_AUDIO_STATS      _IO(AUDIO_FIFO_MAGIC, 6)
 
 #endif
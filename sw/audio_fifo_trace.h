@@ -0,0 +1,58 @@
+/*
+ * Tracepoints for the audio_fifo driver
+ *
+ * Enable with
+ * echo 1 > /sys/kernel/tracing/events/audio_fifo/enable
+ * and read /sys/kernel/tracing/trace_pipe.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM audio_fifo
+
+#if !defined(_AUDIO_FIFO_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _AUDIO_FIFO_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(audio_fifo_ioctl,
+	TP_PROTO(unsigned int cmd, long ret, u64 ns),
+	TP_ARGS(cmd, ret, ns),
+	TP_STRUCT__entry(
+		__field(unsigned int, cmd)
+		__field(long, ret)
+		__field(u64, ns)
+	),
+	TP_fast_assign(
+		__entry->cmd = cmd;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+	TP_printk("cmd=0x%x ret=%ld ns=%llu", __entry->cmd, __entry->ret, __entry->ns)
+);
+
+/* One ring -> FIFO top-up: fill level found, words moved, words left */
+TRACE_EVENT(audio_fifo_refill,
+	TP_PROTO(u32 level, unsigned int moved, unsigned int queued),
+	TP_ARGS(level, moved, queued),
+	TP_STRUCT__entry(
+		__field(u32, level)
+		__field(unsigned int, moved)
+		__field(unsigned int, queued)
+	),
+	TP_fast_assign(
+		__entry->level = level;
+		__entry->moved = moved;
+		__entry->queued = queued;
+	),
+	TP_printk("level=%u moved=%u queued=%u",
+		  __entry->level, __entry->moved, __entry->queued)
+);
+
+#endif /* _AUDIO_FIFO_TRACE_H */
+
+/* This part must be outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE audio_fifo_trace
+#include <trace/define_trace.h>
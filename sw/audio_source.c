@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "audio_fifo.h"
+#include "audio_source.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_SIMD_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_SIMD_SSE2
+#endif
+
+// Q15 multiply with rounding: (sample * gain + 0x4000) >> 15
+static inline int16_t apply_gain(int16_t sample, int16_t gain) {
+    return (int16_t)(((int32_t)sample * gain + 0x4000) >> 15);
+}
+
+// Left and right averaged, rounding down
+static inline int16_t downmix(int16_t left, int16_t right) {
+    return (int16_t)(((int32_t)left + right) >> 1);
+}
+
+// Reference version, also used for the tail of each vector run
+static void pack_mono_scalar(uint32_t* words, const int16_t* samples, size_t frames, int16_t gain) {
+    for (size_t i = 0; i < frames; i++) {
+        words[i] = AUDIO_FIFO_WORD(apply_gain(downmix(samples[2 * i], samples[2 * i + 1]), gain));
+    }
+}
+
+// Downmix interleaved stereo to mono, scale it by a Q15 gain and pack it
+// into FIFO words
+void audio_pack_mono(uint32_t* words, const int16_t* samples, size_t frames, int16_t gain) {
+    size_t i = 0;
+
+#if defined(AUDIO_SIMD_NEON)
+    // 8 frames per iteration: deinterleave, halving add, rounding Q15
+    // multiply, then zip with zeros so each sample lands in an upper half
+    int16x8_t g = vdupq_n_s16(gain);
+    int16x8_t zero = vdupq_n_s16(0);
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t lr = vld2q_s16(samples + 2 * i);
+        int16x8_t mono = vqrdmulhq_s16(vhaddq_s16(lr.val[0], lr.val[1]), g);
+        int16x8x2_t z = vzipq_s16(zero, mono);
+        vst1q_u32(words + i, vreinterpretq_u32_s16(z.val[0]));
+        vst1q_u32(words + i + 4, vreinterpretq_u32_s16(z.val[1]));
+    }
+#elif defined(AUDIO_SIMD_SSE2)
+    // 4 frames per iteration, one per 32-bit lane: left is the lower half,
+    // right the upper.  Sum them at 32 bits, multiply the 16-bit mono by the
+    // gain with madd (its partner is zero), then shift it to the upper half
+    const __m128i g = _mm_set1_epi32((uint16_t)gain);
+    const __m128i low = _mm_set1_epi32(0xFFFF);
+    const __m128i round = _mm_set1_epi32(0x4000);
+    for (; i + 4 <= frames; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(samples + 2 * i));
+        __m128i left = _mm_srai_epi32(_mm_slli_epi32(s, 16), 16);
+        __m128i right = _mm_srai_epi32(s, 16);
+        __m128i mono = _mm_and_si128(_mm_srai_epi32(_mm_add_epi32(left, right), 1), low);
+        __m128i p = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(mono, g), round), 15);
+        _mm_storeu_si128((__m128i*)(words + i), _mm_slli_epi32(p, 16));
+    }
+#endif
+
+    pack_mono_scalar(words + i, samples + 2 * i, frames - i, gain);
+}
+
+// Map a raw file for streaming; returns 0 on success, -1 on error
+int audio_source_open(AudioSource* source, const char* filename) {
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd == -1) {
+        return -1;
+    }
+    if (fstat(fd, &st) == -1 || st.st_size < 4) {
+        close(fd);
+        return -1;
+    }
+
+    source->map_length = st.st_size;
+    source->map = mmap(NULL, source->map_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (source->map == MAP_FAILED) {
+        source->map = NULL;
+        return -1;
+    }
+
+    // We read front to back exactly once: ask for aggressive readahead
+    madvise(source->map, source->map_length, MADV_SEQUENTIAL);
+
+    source->samples = (const int16_t*)source->map;
+    source->frames = source->map_length / (2 * sizeof(int16_t));
+    source->position = 0;
+    return 0;
+}
+
+// Convert up to max_frames frames into FIFO words; returns frames produced
+size_t audio_source_read(AudioSource* source, uint32_t* words, size_t max_frames, int16_t gain) {
+    size_t n = source->frames - source->position;
+
+    if (n > max_frames) {
+        n = max_frames;
+    }
+    audio_pack_mono(words, source->samples + 2 * source->position, n, gain);
+    source->position += n;
+    return n;
+}
+
+// Unmap the file
+void audio_source_close(AudioSource* source) {
+    if (source->map) {
+        munmap(source->map, source->map_length);
+        source->map = NULL;
+    }
+}
+
+// Write every word, looping over the driver's short writes
+int audio_write_all(int fd, const uint32_t* words, size_t count) {
+    const uint8_t* p = (const uint8_t*)words;
+    size_t left = count * sizeof(uint32_t);
+
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        left -= n;
+    }
+    return 0;
+}
+
+// Conversion benchmark
+#ifdef BENCH_AUDIO_SOURCE
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SECONDS 60          // Seconds of 48 kHz audio per pass
+#define BENCH_FRAMES (48000 * BENCH_SECONDS)
+#define BENCH_PASSES 10
+
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char* argv[]) {
+    int16_t* samples = malloc(BENCH_FRAMES * 2 * sizeof(int16_t));
+    uint32_t* words = malloc(BENCH_FRAMES * sizeof(uint32_t));
+    uint32_t* check = malloc(BENCH_FRAMES * sizeof(uint32_t));
+    int16_t gain = GAIN_UNITY / 2;
+
+    if (!samples || !words || !check) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < BENCH_FRAMES * 2; i++) {
+        samples[i] = (int16_t)(rand() - RAND_MAX / 2);
+    }
+
+    // The vector path must agree bit-for-bit with the scalar one
+    pack_mono_scalar(check, samples, BENCH_FRAMES, gain);
+    audio_pack_mono(words, samples, BENCH_FRAMES, gain);
+    if (memcmp(check, words, BENCH_FRAMES * sizeof(uint32_t)) != 0) {
+        fprintf(stderr, "Vector and scalar packing disagree\n");
+        return 1;
+    }
+
+    double t0 = seconds_now();
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        pack_mono_scalar(check, samples, BENCH_FRAMES, gain);
+    }
+    double scalar = seconds_now() - t0;
+
+    t0 = seconds_now();
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        audio_pack_mono(words, samples, BENCH_FRAMES, gain);
+    }
+    double vector = seconds_now() - t0;
+
+    double audio_seconds = (double)BENCH_SECONDS * BENCH_PASSES;
+    printf("scalar: %.1f Mframes/s, %.0fx real time\n",
+           BENCH_FRAMES * BENCH_PASSES / scalar / 1e6, audio_seconds / scalar);
+    printf("vector: %.1f Mframes/s, %.0fx real time\n",
+           BENCH_FRAMES * BENCH_PASSES / vector / 1e6, audio_seconds / vector);
+
+    free(samples);
+    free(words);
+    free(check);
+    return 0;
+}
+#endif
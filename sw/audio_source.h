@@ -0,0 +1,35 @@
+#ifndef _AUDIO_SOURCE_H
+#define _AUDIO_SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GAIN_UNITY 32767          // Q15 gain of (almost) 1.0; gains are 0..GAIN_UNITY
+
+// A raw interleaved stereo int16 file, mapped into memory
+typedef struct {
+    const int16_t* samples;       // Interleaved L/R samples
+    size_t frames;                // Stereo frames in the file
+    size_t position;              // Next frame to convert
+    void* map;                    // The mmap()ed file
+    size_t map_length;            // Length of the mapping in bytes
+} AudioSource;
+
+// Map a raw file for streaming; returns 0 on success, -1 on error
+int audio_source_open(AudioSource* source, const char* filename);
+
+// Convert up to max_frames frames into FIFO words; returns frames produced
+size_t audio_source_read(AudioSource* source, uint32_t* words, size_t max_frames, int16_t gain);
+
+// Unmap the file
+void audio_source_close(AudioSource* source);
+
+// Downmix interleaved stereo to mono, scale it by a Q15 gain and pack it
+// into FIFO words
+void audio_pack_mono(uint32_t* words, const int16_t* samples, size_t frames, int16_t gain);
+
+// Write every word to the audio FIFO device, looping over short writes;
+// returns 0, or -1 with errno set
+int audio_write_all(int fd, const uint32_t* words, size_t count);
+
+#endif // _AUDIO_SOURCE_H
@@ -0,0 +1,78 @@
+#ifndef _DEVICE_H
+#define _DEVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "geo_dash.h"
+#include "audio_fifo.h"
+
+#define MOCK_REGISTERS 13             // Register file, through REG_BACKGROUND_BOTTOM_B
+#define MOCK_LOG_SIZE 256             // Most recent writes kept (power of two)
+#define MOCK_FRAME_NS 16666667LL      // Virtual time per vblank (60 Hz)
+
+// Everything the game needs from the display and audio hardware.  The
+// game keeps its own register shadow; backends only see dirty registers.
+typedef struct Device Device;
+struct Device {
+    const char* name;
+    int has_audio;                    // Whether push_audio goes anywhere
+
+    // Write the registers named in frame->dirty; returns 0 or -1
+    int (*commit_frame)(Device* dev, const geo_dash_frame_t* frame);
+
+    // Load count level columns into the tile map from tile column first
+    // (wrapping at TILE_COLUMNS); returns 0 or -1
+    int (*upload_columns)(Device* dev, int first, const uint8_t* codes, int count);
+
+    // Block until the next vertical blank; returns 0 or -1
+    int (*wait_vsync)(Device* dev);
+
+    // Queue packed FIFO words for playback; returns 0 or -1
+    int (*push_audio)(Device* dev, const uint32_t* words, size_t count);
+
+    // Frames queued ahead of the codec, or -1 if unknown
+    long (*audio_queued)(Device* dev);
+
+    // Audio FIFO statistics; returns 0 or -1.  Reset with stats == NULL
+    int (*audio_stats)(Device* dev, audio_fifo_stats_t* stats);
+
+    // The clock the game loop runs on
+    long long (*now_ns)(Device* dev);
+
+    void (*close)(Device* dev);
+};
+
+// One register write seen by the mock
+typedef struct {
+    uint32_t frame;                   // Vblanks before the write
+    uint8_t reg;                      // Register byte offset (REG_*)
+    uint16_t value;
+} MockWrite;
+
+// What the mock recorded
+typedef struct {
+    uint16_t regs[MOCK_REGISTERS];    // Current register file, by REG_* / 2
+    uint64_t writes[MOCK_REGISTERS];  // Writes per register
+    uint64_t commits;                 // commit_frame() calls
+    uint8_t tiles[TILE_COLUMNS];      // The tile map, by tile column
+    uint64_t tile_writes;             // Tile columns uploaded
+    uint32_t frame;                   // Virtual vblanks so far
+    MockWrite log[MOCK_LOG_SIZE];     // Ring of the latest writes
+    uint64_t log_count;               // Writes ever logged
+    uint64_t audio_words;             // Words pushed
+    audio_fifo_stats_t audio;         // Simulated FIFO statistics
+} MockState;
+
+// The DE1-SoC drivers: registers through mmap() (or WRITE_FRAME ioctls if
+// use_ioctl or mmap is unavailable), vsync through WAIT_VSYNC, audio
+// through /dev/audio_fifo if present.  Returns NULL on failure
+Device* device_open_hardware(int use_ioctl);
+
+// In-memory device on virtual time: never sleeps, records every register
+// write, and plays audio out of a simulated FIFO at 48 kHz
+Device* device_open_mock(void);
+
+// The mock's recorded state, NULL for other backends
+const MockState* device_mock_state(const Device* dev);
+
+#endif // _DEVICE_H
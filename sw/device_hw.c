@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "audio_source.h"
+#include "device.h"
+
+#define FALLBACK_FRAME_US 16667       // Pacing without the vblank IRQ (~60 FPS)
+
+typedef struct {
+    Device dev;                       // Must be first
+    int fd;                           // /dev/player_sprite_0
+    int audio_fd;                     // /dev/audio_fifo, -1 without sound
+    void* reg_page;                   // mmap()ed register page, NULL for ioctls
+    volatile uint16_t* reg_base;      // Register block within reg_page
+    long reg_page_size;               // Size of the mapping
+    int vsync_available;              // Cleared once WAIT_VSYNC turns out unsupported
+    uint32_t vsync_frame;             // Hardware frame counter from the last vblank
+} HardwareDevice;
+
+static HardwareDevice hw;
+
+static int map_registers(HardwareDevice* h) {
+    // Map the page holding the player_sprite registers
+    uint32_t offset;
+
+    if (ioctl(h->fd, READ_MMAP_OFFSET, &offset) == -1) {
+        return 0;
+    }
+
+    h->reg_page_size = sysconf(_SC_PAGESIZE);
+    h->reg_page = mmap(NULL, h->reg_page_size, PROT_READ | PROT_WRITE, MAP_SHARED, h->fd, 0);
+    if (h->reg_page == MAP_FAILED) {
+        h->reg_page = NULL;
+        return 0;
+    }
+
+    h->reg_base = (volatile uint16_t*)((uint8_t*)h->reg_page + offset);
+    return 1;
+}
+
+static int hw_commit_frame(Device* dev, const geo_dash_frame_t* frame) {
+    HardwareDevice* h = (HardwareDevice*)dev;
+    const geo_dash_arg_t* regs = &frame->regs;
+
+    if (!h->reg_page) {
+        // ioctl backend: all dirty registers in one kernel entry
+        if (ioctl(h->fd, WRITE_FRAME, frame) == -1) {
+            perror("ioctl(WRITE_FRAME) failed");
+            return -1;
+        }
+        return 0;
+    }
+
+    // mmap backend: plain uncached stores, no kernel entry at all
+    if (frame->dirty & DIRTY_PLAYER_Y) h->reg_base[REG_PLAYER_Y_POS / 2] = regs->player_y;
+    if (frame->dirty & DIRTY_X_SHIFT) h->reg_base[REG_X_SHIFT / 2] = regs->x_shift;
+    if (frame->dirty & DIRTY_BACKGROUND_R) h->reg_base[REG_BACKGROUND_R / 2] = regs->bg_r;
+    if (frame->dirty & DIRTY_BACKGROUND_G) h->reg_base[REG_BACKGROUND_G / 2] = regs->bg_g;
+    if (frame->dirty & DIRTY_BACKGROUND_B) h->reg_base[REG_BACKGROUND_B / 2] = regs->bg_b;
+    if (frame->dirty & DIRTY_MAP_BLOCK) h->reg_base[REG_MAP_BLOCK / 2] = regs->map_block;
+    if (frame->dirty & DIRTY_FLAGS) h->reg_base[REG_FLAGS / 2] = regs->flags;
+    if (frame->dirty & DIRTY_OUTPUT_FLAGS) h->reg_base[REG_OUTPUT_FLAGS / 2] = regs->output_flags;
+    if (frame->dirty & DIRTY_BACKGROUND_BOTTOM_R) h->reg_base[REG_BACKGROUND_BOTTOM_R / 2] = regs->bg_bottom_r;
+    if (frame->dirty & DIRTY_BACKGROUND_BOTTOM_G) h->reg_base[REG_BACKGROUND_BOTTOM_G / 2] = regs->bg_bottom_g;
+    if (frame->dirty & DIRTY_BACKGROUND_BOTTOM_B) h->reg_base[REG_BACKGROUND_BOTTOM_B / 2] = regs->bg_bottom_b;
+    return 0;
+}
+
+static int hw_upload_columns(Device* dev, int first, const uint8_t* codes, int count) {
+    HardwareDevice* h = (HardwareDevice*)dev;
+
+    if (!h->reg_page) {
+        geo_dash_columns_t columns;
+
+        columns.first = first % TILE_COLUMNS;
+        columns.count = count < TILE_COLUMNS ? count : TILE_COLUMNS;
+        memcpy(columns.codes, codes, columns.count);
+        if (ioctl(h->fd, WRITE_TILE_COLUMNS, &columns) == -1) {
+            perror("ioctl(WRITE_TILE_COLUMNS) failed");
+            return -1;
+        }
+        return 0;
+    }
+
+    // One store per column; the hardware expands each code into tiles
+    for (int i = 0; i < count; i++) {
+        int column = (first + i) % TILE_COLUMNS;
+        h->reg_base[REG_TILE_COLUMN / 2] = column << TILE_COLUMN_SHIFT | codes[i];
+    }
+    return 0;
+}
+
+static int hw_wait_vsync(Device* dev) {
+    HardwareDevice* h = (HardwareDevice*)dev;
+
+    // Pace the loop to the real scanout; fall back to a timer without the IRQ
+    if (h->vsync_available) {
+        if (ioctl(h->fd, WAIT_VSYNC, &h->vsync_frame) == 0 || errno == EINTR) {
+            return 0;
+        }
+        perror("ioctl(WAIT_VSYNC) failed, pacing with usleep");
+        h->vsync_available = 0;
+    }
+    usleep(FALLBACK_FRAME_US);
+    return 0;
+}
+
+static int hw_push_audio(Device* dev, const uint32_t* words, size_t count) {
+    HardwareDevice* h = (HardwareDevice*)dev;
+
+    if (audio_write_all(h->audio_fd, words, count) == -1) {
+        perror("write to audio_fifo failed");
+        return -1;
+    }
+    return 0;
+}
+
+static long hw_audio_queued(Device* dev) {
+    HardwareDevice* h = (HardwareDevice*)dev;
+    uint32_t queued;
+
+    if (ioctl(h->audio_fd, READ_AUDIO_QUEUED, &queued) == -1) {
+        return -1;
+    }
+    return queued;
+}
+
+static int hw_audio_stats(Device* dev, audio_fifo_stats_t* stats) {
+    HardwareDevice* h = (HardwareDevice*)dev;
+
+    if (!stats) {
+        return ioctl(h->audio_fd, RESET_AUDIO_STATS) == -1 ? -1 : 0;
+    }
+    return ioctl(h->audio_fd, READ_AUDIO_STATS, stats) == -1 ? -1 : 0;
+}
+
+static long long hw_now_ns(Device* dev) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void hw_close(Device* dev) {
+    HardwareDevice* h = (HardwareDevice*)dev;
+
+    if (h->reg_page) {
+        munmap(h->reg_page, h->reg_page_size);
+        h->reg_page = NULL;
+    }
+    if (h->audio_fd != -1) {
+        close(h->audio_fd);
+        h->audio_fd = -1;
+    }
+    close(h->fd);
+}
+
+Device* device_open_hardware(int use_ioctl) {
+    HardwareDevice* h = &hw;
+
+    h->fd = open("/dev/player_sprite_0", O_RDWR);
+    if (h->fd == -1) {
+        perror("Error opening device");
+        return NULL;
+    }
+
+    // Prefer writing registers directly; fall back to ioctls
+    h->reg_page = NULL;
+    if (!use_ioctl && !map_registers(h)) {
+        printf("Register mmap unavailable, using ioctl backend\n");
+    }
+    h->vsync_available = 1;
+
+    // Sound is optional: the game runs silently without the audio FIFO
+    h->audio_fd = open("/dev/audio_fifo", O_WRONLY);
+
+    h->dev = (Device){
+        .name = "hardware",
+        .has_audio = h->audio_fd != -1,
+        .commit_frame = hw_commit_frame,
+        .upload_columns = hw_upload_columns,
+        .wait_vsync = hw_wait_vsync,
+        .push_audio = hw_push_audio,
+        .audio_queued = hw_audio_queued,
+        .audio_stats = hw_audio_stats,
+        .now_ns = hw_now_ns,
+        .close = hw_close,
+    };
+    return &h->dev;
+}
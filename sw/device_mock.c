@@ -0,0 +1,154 @@
+#include <string.h>
+#include <stdint.h>
+#include "device.h"
+
+#define MOCK_AUDIO_RATE 48000         // Frames the simulated codec plays per second
+
+typedef struct {
+    Device dev;                       // Must be first
+    MockState state;
+    long long now_ns;                 // Virtual clock, advanced only by vsync
+    long long played;                 // Audio frames the codec has consumed
+    long long queued;                 // Audio frames pushed but not yet played
+} MockDevice;
+
+static MockDevice mock;
+
+static void log_write(MockState* st, int reg, uint16_t value) {
+    MockWrite* w = &st->log[st->log_count++ & (MOCK_LOG_SIZE - 1)];
+    w->frame = st->frame;
+    w->reg = reg;
+    w->value = value;
+    if (reg / 2 < MOCK_REGISTERS) {
+        st->regs[reg / 2] = value;
+        st->writes[reg / 2]++;
+    }
+}
+
+static int mock_commit_frame(Device* dev, const geo_dash_frame_t* frame) {
+    MockState* st = &((MockDevice*)dev)->state;
+    const geo_dash_arg_t* regs = &frame->regs;
+
+    // Same order as the driver's write_frame()
+    if (frame->dirty & DIRTY_PLAYER_Y) log_write(st, REG_PLAYER_Y_POS, regs->player_y);
+    if (frame->dirty & DIRTY_X_SHIFT) log_write(st, REG_X_SHIFT, regs->x_shift);
+    if (frame->dirty & DIRTY_BACKGROUND_R) log_write(st, REG_BACKGROUND_R, regs->bg_r);
+    if (frame->dirty & DIRTY_BACKGROUND_G) log_write(st, REG_BACKGROUND_G, regs->bg_g);
+    if (frame->dirty & DIRTY_BACKGROUND_B) log_write(st, REG_BACKGROUND_B, regs->bg_b);
+    if (frame->dirty & DIRTY_MAP_BLOCK) log_write(st, REG_MAP_BLOCK, regs->map_block);
+    if (frame->dirty & DIRTY_FLAGS) log_write(st, REG_FLAGS, regs->flags);
+    if (frame->dirty & DIRTY_OUTPUT_FLAGS) log_write(st, REG_OUTPUT_FLAGS, regs->output_flags);
+    if (frame->dirty & DIRTY_BACKGROUND_BOTTOM_R) log_write(st, REG_BACKGROUND_BOTTOM_R, regs->bg_bottom_r);
+    if (frame->dirty & DIRTY_BACKGROUND_BOTTOM_G) log_write(st, REG_BACKGROUND_BOTTOM_G, regs->bg_bottom_g);
+    if (frame->dirty & DIRTY_BACKGROUND_BOTTOM_B) log_write(st, REG_BACKGROUND_BOTTOM_B, regs->bg_bottom_b);
+    st->commits++;
+    return 0;
+}
+
+static int mock_upload_columns(Device* dev, int first, const uint8_t* codes, int count) {
+    MockState* st = &((MockDevice*)dev)->state;
+
+    // Same writes as the driver's write_tile_columns()
+    for (int i = 0; i < count; i++) {
+        int column = (first + i) % TILE_COLUMNS;
+        log_write(st, REG_TILE_COLUMN, column << TILE_COLUMN_SHIFT | codes[i]);
+        st->tiles[column] = codes[i];
+        st->tile_writes++;
+    }
+    return 0;
+}
+
+// Let the simulated codec play up to the current virtual time
+static void play_audio(MockDevice* m) {
+    long long due = m->now_ns * MOCK_AUDIO_RATE / 1000000000LL - m->played;
+
+    m->played += due;
+    if (due > m->queued) {
+        // Ran dry mid-stream, as the FIFO's UNDERFLOW event would report
+        if (m->state.audio_words > 0) {
+            m->state.audio.underflows++;
+        }
+        m->queued = 0;
+    } else {
+        m->queued -= due;
+    }
+}
+
+static int mock_wait_vsync(Device* dev) {
+    MockDevice* m = (MockDevice*)dev;
+
+    m->now_ns += MOCK_FRAME_NS;
+    m->state.frame++;
+    play_audio(m);
+    return 0;
+}
+
+static int mock_push_audio(Device* dev, const uint32_t* words, size_t count) {
+    MockDevice* m = (MockDevice*)dev;
+    audio_fifo_stats_t* st = &m->state.audio;
+    uint32_t level = m->queued < AUDIO_FIFO_DEPTH ? m->queued : AUDIO_FIFO_DEPTH;
+
+    // Fill level as the driver would sample it before a top-up
+    if (m->state.audio_words > 0) {
+        if (level < st->min_fill) {
+            st->min_fill = level;
+        }
+        st->fill_samples++;
+
+        // Same buckets as the driver's record_fill(), full FIFO in the last
+        uint32_t bucket = level / (AUDIO_FIFO_DEPTH / AUDIO_FILL_BUCKETS);
+        st->fill_histogram[bucket < AUDIO_FILL_BUCKETS - 1 ? bucket : AUDIO_FILL_BUCKETS - 1]++;
+    }
+
+    m->queued += count;
+    m->state.audio_words += count;
+    st->samples_written += count;
+    return 0;
+}
+
+static long mock_audio_queued(Device* dev) {
+    return ((MockDevice*)dev)->queued;
+}
+
+static int mock_audio_stats(Device* dev, audio_fifo_stats_t* stats) {
+    MockDevice* m = (MockDevice*)dev;
+
+    if (!stats) {
+        memset(&m->state.audio, 0, sizeof(m->state.audio));
+        m->state.audio.min_fill = AUDIO_FIFO_DEPTH;
+        return 0;
+    }
+    *stats = m->state.audio;
+    return 0;
+}
+
+static long long mock_now_ns(Device* dev) {
+    return ((MockDevice*)dev)->now_ns;
+}
+
+static void mock_close(Device* dev) {
+}
+
+Device* device_open_mock(void) {
+    MockDevice* m = &mock;
+
+    memset(m, 0, sizeof(*m));
+    m->state.audio.min_fill = AUDIO_FIFO_DEPTH;
+    m->dev = (Device){
+        .name = "mock",
+        .has_audio = 1,
+        .commit_frame = mock_commit_frame,
+        .upload_columns = mock_upload_columns,
+        .wait_vsync = mock_wait_vsync,
+        .push_audio = mock_push_audio,
+        .audio_queued = mock_audio_queued,
+        .audio_stats = mock_audio_stats,
+        .now_ns = mock_now_ns,
+        .close = mock_close,
+    };
+    return &m->dev;
+}
+
+const MockState* device_mock_state(const Device* dev) {
+    return dev == &mock.dev ? &mock.state : NULL;
+}
@@ -0,0 +1,108 @@
+/*
+ * Per-command statistics shared by the geo_dash and audio_fifo drivers
+ *
+ * Each driver keeps a table of struct drv_cmd_stats, one per ioctl (and
+ * per other hot path it wants to watch), and exposes it through debugfs
+ * as <debugfs>/<driver>/stats.  Reading the file prints call counts,
+ * cumulative time and a log2 histogram of per-call time; writing anything
+ * to it clears the counters.
+ *
+ * Counters are atomics so recording costs a few instructions and never
+ * takes a lock; it is cheap enough to leave on in production builds.
+ */
+
+#ifndef _DRIVER_STATS_H
+#define _DRIVER_STATS_H
+
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
+#include <linux/timekeeping.h>
+
+#define DRV_STATS_BUCKETS 24   /* Bucket b counts calls of [2^b, 2^(b+1)) ns */
+
+struct drv_cmd_stats {
+	const char *name;              /* NULL for unused table slots */
+	atomic64_t calls;
+	atomic64_t ns;                 /* Total time spent in the command */
+	atomic_t hist[DRV_STATS_BUCKETS];
+};
+
+struct drv_stats {
+	struct drv_cmd_stats *cmds;
+	int count;
+};
+
+static inline void drv_stats_record(struct drv_cmd_stats *s, u64 ns)
+{
+	int bucket = ns ? min_t(int, ilog2(ns), DRV_STATS_BUCKETS - 1) : 0;
+
+	atomic64_inc(&s->calls);
+	atomic64_add(ns, &s->ns);
+	atomic_inc(&s->hist[bucket]);
+}
+
+static int drv_stats_show(struct seq_file *m, void *unused)
+{
+	struct drv_stats *stats = m->private;
+	int i, b;
+
+	seq_puts(m, "# command calls total_ns hist[log2 ns]\n");
+	for (i = 0; i < stats->count; i++) {
+		struct drv_cmd_stats *s = &stats->cmds[i];
+
+		if (!s->name)
+			continue;
+		seq_printf(m, "%-22s %llu %llu", s->name,
+			   (u64)atomic64_read(&s->calls), (u64)atomic64_read(&s->ns));
+		for (b = 0; b < DRV_STATS_BUCKETS; b++)
+			seq_printf(m, " %d", atomic_read(&s->hist[b]));
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int drv_stats_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, drv_stats_show, inode->i_private);
+}
+
+static ssize_t drv_stats_write(struct file *f, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct drv_stats *stats = ((struct seq_file *)f->private_data)->private;
+	int i, b;
+
+	for (i = 0; i < stats->count; i++) {
+		struct drv_cmd_stats *s = &stats->cmds[i];
+
+		atomic64_set(&s->calls, 0);
+		atomic64_set(&s->ns, 0);
+		for (b = 0; b < DRV_STATS_BUCKETS; b++)
+			atomic_set(&s->hist[b], 0);
+	}
+	return count;
+}
+
+static const struct file_operations drv_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = drv_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.write = drv_stats_write,
+	.release = single_release,
+};
+
+/* Create <debugfs>/<name>/stats; remove with debugfs_remove_recursive() */
+static inline struct dentry *drv_stats_debugfs(const char *name, struct drv_stats *stats)
+{
+	struct dentry *dir = debugfs_create_dir(name, NULL);
+
+	debugfs_create_file("stats", 0600, dir, stats, &drv_stats_fops);
+	return dir;
+}
+
+#endif /* _DRIVER_STATS_H */
@@ -33,7 +33,17 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/ioctl.h>
+#include <linux/mm.h>
+#include <linux/interrupt.h>
+#include <linux/of_irq.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/ktime.h>
 #include "geo_dash.h"
+#include "driver_stats.h"
+
+#define CREATE_TRACE_POINTS
+#include "geo_dash_trace.h"
 
 // =============================================
 // ===== geo_dash structures and constants =====
@@ -41,16 +51,22 @@
 
 #define DRIVER_NAME "player_sprite_0"
 // Assuming that we have 16-bit registers.
-#define PLAYER_Y_POS(base)   ((base) + 0x00)  // 16-bit
-#define X_SHIFT(base)        ((base) + 0x02)  // 16-bit
+#define PLAYER_Y_POS(base)   ((base) + REG_PLAYER_Y_POS)  // 16-bit
+#define X_SHIFT(base)        ((base) + REG_X_SHIFT)       // 16-bit
+
+#define BACKGROUND_R(base)   ((base) + REG_BACKGROUND_R)  // lower 8 bits used
+#define BACKGROUND_G(base)   ((base) + REG_BACKGROUND_G)  // lower 8 bits used
+#define BACKGROUND_B(base)   ((base) + REG_BACKGROUND_B)  // lower 8 bits used
 
-#define BACKGROUND_R(base)   ((base) + 0x04)  // lower 8 bits used
-#define BACKGROUND_G(base)   ((base) + 0x06)  // lower 8 bits used
-#define BACKGROUND_B(base)   ((base) + 0x08)  // lower 8 bits used
+#define MAP_BLOCK(base)      ((base) + REG_MAP_BLOCK)     // lower 8 bits used
+#define FLAGS(base)          ((base) + REG_FLAGS)         // lower 8 bits used
+#define OUTPUT_FLAGS(base)   ((base) + REG_OUTPUT_FLAGS)  // lower 8 bits used
+#define IRQ_CONTROL(base)    ((base) + REG_IRQ_CONTROL)   // enable/ack bits
+#define TILE_COLUMN(base)    ((base) + REG_TILE_COLUMN)   // column << 8 | code
 
-#define MAP_BLOCK(base)      ((base) + 0x0A)  // lower 8 bits used
-#define FLAGS(base)          ((base) + 0x0C)  // lower 8 bits used
-#define OUTPUT_FLAGS(base)   ((base) + 0x0E)  // lower 8 bits used
+#define BACKGROUND_BOTTOM_R(base) ((base) + REG_BACKGROUND_BOTTOM_R)  // lower 8 bits used
+#define BACKGROUND_BOTTOM_G(base) ((base) + REG_BACKGROUND_BOTTOM_G)  // lower 8 bits used
+#define BACKGROUND_BOTTOM_B(base) ((base) + REG_BACKGROUND_BOTTOM_B)  // lower 8 bits used
 
 /*
 Information about our geometry_dash device. Acts as a mirror of hardware state.
@@ -60,8 +76,51 @@ struct geo_dash_dev {
     struct resource res; /* Our registers. */
     void __iomem *virtbase; /* Where our registers can be accessed in memory. */
     short x_shift;
+    int irq; /* Vblank interrupt, 0 if the device tree has none. */
+    atomic_t frame_count; /* Vblanks seen since probe. */
+    wait_queue_head_t vsync_wait; /* Readers sleeping until the next vblank. */
+    struct dentry *debugfs; /* Our directory under debugfs. */
 } geo_dash_dev;
 
+/*
+Call counts and timings, indexed by ioctl number, for debugfs.  An
+ioctl's time covers the whole handler: the register writes for the WRITE
+commands, the sleep for WAIT_VSYNC.
+*/
+#define STAT_VBLANK_IRQ 15
+
+static struct drv_cmd_stats geo_dash_cmd_stats[] = {
+    [_IOC_NR(WRITE_X_SHIFT)]      = { .name = "WRITE_X_SHIFT" },
+    [_IOC_NR(WRITE_PLAYER_Y_POS)] = { .name = "WRITE_PLAYER_Y_POS" },
+    [_IOC_NR(WRITE_BACKGROUND_R)] = { .name = "WRITE_BACKGROUND_R" },
+    [_IOC_NR(WRITE_BACKGROUND_G)] = { .name = "WRITE_BACKGROUND_G" },
+    [_IOC_NR(WRITE_BACKGROUND_B)] = { .name = "WRITE_BACKGROUND_B" },
+    [_IOC_NR(WRITE_MAP_BLOCK)]    = { .name = "WRITE_MAP_BLOCK" },
+    [_IOC_NR(WRITE_FLAGS)]        = { .name = "WRITE_FLAGS" },
+    [_IOC_NR(WRITE_OUTPUT_FLAGS)] = { .name = "WRITE_OUTPUT_FLAGS" },
+    [_IOC_NR(WRITE_FRAME)]        = { .name = "WRITE_FRAME" },
+    [_IOC_NR(READ_MMAP_OFFSET)]   = { .name = "READ_MMAP_OFFSET" },
+    [_IOC_NR(WAIT_VSYNC)]         = { .name = "WAIT_VSYNC" },
+    [_IOC_NR(WRITE_TILE_COLUMNS)] = { .name = "WRITE_TILE_COLUMNS" },
+    [_IOC_NR(WRITE_BACKGROUND_BOTTOM_R)] = { .name = "WRITE_BACKGROUND_BOTTOM_R" },
+    [_IOC_NR(WRITE_BACKGROUND_BOTTOM_G)] = { .name = "WRITE_BACKGROUND_BOTTOM_G" },
+    [_IOC_NR(WRITE_BACKGROUND_BOTTOM_B)] = { .name = "WRITE_BACKGROUND_BOTTOM_B" },
+    [STAT_VBLANK_IRQ]             = { .name = "vblank_irq" },
+};
+
+static struct drv_stats geo_dash_stats = {
+    .cmds = geo_dash_cmd_stats,
+    .count = ARRAY_SIZE(geo_dash_cmd_stats),
+};
+
+/*
+Per-open state: the last frame count this file has been told about, so
+read() and poll() report each vblank exactly once per reader.
+*/
+struct geo_dash_file {
+    u32 last_frame;
+};
+
 static void write_player_y_position(unsigned short *value) {
     iowrite16(*value, PLAYER_Y_POS(geo_dash_dev.virtbase));
 }
@@ -83,6 +142,18 @@ static void write_background_b(uint8_t *value) {
     iowrite16((uint16_t)(*value), BACKGROUND_B(geo_dash_dev.virtbase));
 }
 
+static void write_background_bottom_r(uint8_t *value) {
+    iowrite16((uint16_t)(*value), BACKGROUND_BOTTOM_R(geo_dash_dev.virtbase));
+}
+
+static void write_background_bottom_g(uint8_t *value) {
+    iowrite16((uint16_t)(*value), BACKGROUND_BOTTOM_G(geo_dash_dev.virtbase));
+}
+
+static void write_background_bottom_b(uint8_t *value) {
+    iowrite16((uint16_t)(*value), BACKGROUND_BOTTOM_B(geo_dash_dev.virtbase));
+}
+
 static void write_map_block(uint8_t *value) {
     iowrite16((uint16_t)(*value), MAP_BLOCK(geo_dash_dev.virtbase));
 }
@@ -95,10 +166,118 @@ static void write_output_flags(uint8_t *value) {
     iowrite16((uint16_t)(*value), OUTPUT_FLAGS(geo_dash_dev.virtbase));
 }
 
-static long geo_dash_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
+/*
+Load level columns into the tile map, one register write per column.
+*/
+static void write_tile_columns(geo_dash_columns_t *columns) {
+    int count = min_t(int, columns->count, TILE_COLUMNS);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        u16 column = (columns->first + i) % TILE_COLUMNS;
+        iowrite16(column << TILE_COLUMN_SHIFT | columns->codes[i],
+                  TILE_COLUMN(geo_dash_dev.virtbase));
+    }
+}
+
+static irqreturn_t geo_dash_irq(int irq, void *dev_id)
+{
+    u64 start = ktime_get_ns();
+
+    // Acknowledge the vblank and wake everyone waiting for it
+    iowrite16(IRQ_VBLANK_ENABLE | IRQ_VBLANK_ACK, IRQ_CONTROL(geo_dash_dev.virtbase));
+    trace_geo_dash_vblank(atomic_inc_return(&geo_dash_dev.frame_count));
+    wake_up_interruptible(&geo_dash_dev.vsync_wait);
+    drv_stats_record(&geo_dash_cmd_stats[STAT_VBLANK_IRQ], ktime_get_ns() - start);
+    return IRQ_HANDLED;
+}
+
+/*
+Sleep until the frame counter moves past after; return the new count.
+*/
+static int wait_for_frame(u32 after, u32 *frame) {
+    if (!geo_dash_dev.irq)
+        return -ENODEV;
+    if (wait_event_interruptible(geo_dash_dev.vsync_wait,
+            (u32) atomic_read(&geo_dash_dev.frame_count) != after))
+        return -ERESTARTSYS;
+    *frame = atomic_read(&geo_dash_dev.frame_count);
+    return 0;
+}
+
+/*
+Write every register named in the frame's dirty mask, in register order.
+*/
+static void write_frame(geo_dash_frame_t *frame) {
+    geo_dash_arg_t *regs = &frame->regs;
+
+    if (frame->dirty & DIRTY_PLAYER_Y)
+        write_player_y_position(&regs->player_y);
+    if (frame->dirty & DIRTY_X_SHIFT)
+        write_x_shift(&regs->x_shift);
+    if (frame->dirty & DIRTY_BACKGROUND_R)
+        write_background_r(&regs->bg_r);
+    if (frame->dirty & DIRTY_BACKGROUND_G)
+        write_background_g(&regs->bg_g);
+    if (frame->dirty & DIRTY_BACKGROUND_B)
+        write_background_b(&regs->bg_b);
+    if (frame->dirty & DIRTY_MAP_BLOCK)
+        write_map_block(&regs->map_block);
+    if (frame->dirty & DIRTY_FLAGS)
+        write_flags(&regs->flags);
+    if (frame->dirty & DIRTY_OUTPUT_FLAGS)
+        write_output_flags(&regs->output_flags);
+    if (frame->dirty & DIRTY_BACKGROUND_BOTTOM_R)
+        write_background_bottom_r(&regs->bg_bottom_r);
+    if (frame->dirty & DIRTY_BACKGROUND_BOTTOM_G)
+        write_background_bottom_g(&regs->bg_bottom_g);
+    if (frame->dirty & DIRTY_BACKGROUND_BOTTOM_B)
+        write_background_bottom_b(&regs->bg_bottom_b);
+}
+
+static long geo_dash_do_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 {
     geo_dash_arg_t vla;
-	printk(KERN_INFO "geo_dash_ioctl called with cmd 0x%x\n", cmd);
+    geo_dash_frame_t frame;
+    geo_dash_columns_t columns;
+
+    // Tell userspace where the registers sit within the mmap()ed page
+    if (cmd == READ_MMAP_OFFSET) {
+        uint32_t offset = geo_dash_dev.res.start & ~PAGE_MASK;
+        if (copy_to_user((uint32_t *) arg, &offset, sizeof(offset)))
+            return -EFAULT;
+        return 0;
+    }
+
+    // Block until the next vblank and return the frame counter
+    if (cmd == WAIT_VSYNC) {
+        struct geo_dash_file *gf = f->private_data;
+        u32 frame;
+        int ret = wait_for_frame(atomic_read(&geo_dash_dev.frame_count), &frame);
+        if (ret)
+            return ret;
+        gf->last_frame = frame;
+        if (copy_to_user((uint32_t *) arg, &frame, sizeof(frame)))
+            return -EFAULT;
+        return 0;
+    }
+
+    // A frame commit carries its own, larger struct
+    if (cmd == WRITE_FRAME) {
+        if (copy_from_user(&frame, (geo_dash_frame_t *) arg, sizeof(frame)))
+            return -EFAULT;
+        trace_geo_dash_frame(frame.dirty);
+        write_frame(&frame);
+        return 0;
+    }
+
+    // Level columns for the tile map
+    if (cmd == WRITE_TILE_COLUMNS) {
+        if (copy_from_user(&columns, (geo_dash_columns_t *) arg, sizeof(columns)))
+            return -EFAULT;
+        write_tile_columns(&columns);
+        return 0;
+    }
 
     // Copy user struct into kernel space
     if (copy_from_user(&vla, (geo_dash_arg_t *) arg, sizeof(vla)))
@@ -137,6 +316,18 @@ static long geo_dash_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
             write_output_flags(&vla.output_flags);
             break;
 
+        case WRITE_BACKGROUND_BOTTOM_R:
+            write_background_bottom_r(&vla.bg_bottom_r);
+            break;
+
+        case WRITE_BACKGROUND_BOTTOM_G:
+            write_background_bottom_g(&vla.bg_bottom_g);
+            break;
+
+        case WRITE_BACKGROUND_BOTTOM_B:
+            write_background_bottom_b(&vla.bg_bottom_b);
+            break;
+
         default:
             return -EINVAL;  // Unknown command
     }
@@ -144,9 +335,108 @@ static long geo_dash_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
     return 0;
 }
 
+/*
+Time every ioctl for the debugfs stats and the geo_dash_ioctl tracepoint.
+*/
+static long geo_dash_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
+{
+    u64 start = ktime_get_ns();
+    long ret = geo_dash_do_ioctl(f, cmd, arg);
+    u64 ns = ktime_get_ns() - start;
+
+    if (_IOC_TYPE(cmd) == GEO_DASH_MAGIC && _IOC_NR(cmd) < STAT_VBLANK_IRQ)
+        drv_stats_record(&geo_dash_cmd_stats[_IOC_NR(cmd)], ns);
+    trace_geo_dash_ioctl(cmd, ret, ns);
+    return ret;
+}
+
+/*
+Map the page(s) holding our registers into userspace, uncached, so the
+game can update them with plain stores instead of ioctls.  Anything else
+on those pages would be writable too, so the registers must start a page
+the system gives to player_sprite alone (0x15000 in soc_system.qsys);
+with an unaligned base, userspace falls back to the ioctls.
+*/
+static int geo_dash_mmap(struct file *f, struct vm_area_struct *vma)
+{
+    unsigned long size = vma->vm_end - vma->vm_start;
+    phys_addr_t start = geo_dash_dev.res.start;
+    unsigned long span = PAGE_ALIGN(resource_size(&geo_dash_dev.res));
+
+    if (start & ~PAGE_MASK)
+        return -ENODEV;
+    if (vma->vm_pgoff != 0 || size > span)
+        return -EINVAL;
+
+    vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+    return io_remap_pfn_range(vma, vma->vm_start, start >> PAGE_SHIFT,
+                              size, vma->vm_page_prot);
+}
+
+static int geo_dash_open(struct inode *inode, struct file *f)
+{
+    struct geo_dash_file *gf = kzalloc(sizeof(*gf), GFP_KERNEL);
+
+    if (!gf)
+        return -ENOMEM;
+    gf->last_frame = atomic_read(&geo_dash_dev.frame_count);
+    f->private_data = gf;
+    return 0;
+}
+
+static int geo_dash_release(struct inode *inode, struct file *f)
+{
+    kfree(f->private_data);
+    return 0;
+}
+
+/*
+read() returns the 32-bit frame counter once per vblank, blocking until a
+vblank this reader has not seen yet (or -EAGAIN with O_NONBLOCK).
+*/
+static ssize_t geo_dash_read(struct file *f, char __user *buf, size_t count, loff_t *ppos)
+{
+    struct geo_dash_file *gf = f->private_data;
+    u32 frame = atomic_read(&geo_dash_dev.frame_count);
+    int ret;
+
+    if (count < sizeof(frame))
+        return -EINVAL;
+    if (!geo_dash_dev.irq)
+        return -ENODEV;
+
+    if (frame == gf->last_frame) {
+        if (f->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_for_frame(gf->last_frame, &frame);
+        if (ret)
+            return ret;
+    }
+
+    gf->last_frame = frame;
+    if (copy_to_user(buf, &frame, sizeof(frame)))
+        return -EFAULT;
+    return sizeof(frame);
+}
+
+static __poll_t geo_dash_poll(struct file *f, poll_table *wait)
+{
+    struct geo_dash_file *gf = f->private_data;
+
+    poll_wait(f, &geo_dash_dev.vsync_wait, wait);
+    if ((u32) atomic_read(&geo_dash_dev.frame_count) != gf->last_frame)
+        return EPOLLIN | EPOLLRDNORM;
+    return 0;
+}
+
 static const struct file_operations geo_dash_fops = {
     .owner = THIS_MODULE,
-    .unlocked_ioctl = geo_dash_ioctl
+    .open = geo_dash_open,
+    .release = geo_dash_release,
+    .read = geo_dash_read,
+    .poll = geo_dash_poll,
+    .unlocked_ioctl = geo_dash_ioctl,
+    .mmap = geo_dash_mmap
 };
 
 static struct miscdevice geo_dash_misc_device = {
@@ -166,22 +456,18 @@ static int __init geo_dash_probe(struct platform_device *pdev)
 	int ret;
 	pr_info("geo_dash: probe successful\n");
 
-	/* Register ourselves as a misc device: creates /dev/geo_dash */
-	ret = misc_register(&geo_dash_misc_device);
+	atomic_set(&geo_dash_dev.frame_count, 0);
+	init_waitqueue_head(&geo_dash_dev.vsync_wait);
 
 	/* Get the address of our registers from the device tree */
 	ret = of_address_to_resource(pdev->dev.of_node, 0, &geo_dash_dev.res);
-	if (ret) {
-		ret = -ENOENT;
-		goto out_deregister;
-	}
+	if (ret)
+		return -ENOENT;
 
 	/* Make sure we can use these registers */
 	if (request_mem_region(geo_dash_dev.res.start, resource_size(&geo_dash_dev.res),
-			       DRIVER_NAME) == NULL) {
-		ret = -EBUSY;
-		goto out_deregister;
-	}
+			       DRIVER_NAME) == NULL)
+		return -EBUSY;
 	
 	/* Arrange access to our registers */
 	geo_dash_dev.virtbase = of_iomap(pdev->dev.of_node, 0);
@@ -190,21 +476,57 @@ static int __init geo_dash_probe(struct platform_device *pdev)
 		goto out_release_mem_region;
 	}
 
+	/* Hook up the vblank interrupt; without it only polling pacing works */
+	geo_dash_dev.irq = irq_of_parse_and_map(pdev->dev.of_node, 0);
+	if (geo_dash_dev.irq) {
+		ret = request_irq(geo_dash_dev.irq, geo_dash_irq, 0, DRIVER_NAME, &geo_dash_dev);
+		if (ret) {
+			irq_dispose_mapping(geo_dash_dev.irq);
+			geo_dash_dev.irq = 0;
+			goto out_unmap;
+		}
+		iowrite16(IRQ_VBLANK_ENABLE | IRQ_VBLANK_ACK, IRQ_CONTROL(geo_dash_dev.virtbase));
+	} else {
+		pr_warn(DRIVER_NAME ": no vblank interrupt, WAIT_VSYNC disabled\n");
+	}
+
+	/*
+	 * Register ourselves as a misc device last: creates /dev/geo_dash,
+	 * and ioctl() and mmap() may run as soon as it exists
+	 */
+	ret = misc_register(&geo_dash_misc_device);
+	if (ret)
+		goto out_free_irq;
+
+	geo_dash_dev.debugfs = drv_stats_debugfs("geo_dash", &geo_dash_stats);
 	return 0;
 
+out_free_irq:
+	if (geo_dash_dev.irq) {
+		iowrite16(IRQ_VBLANK_ACK, IRQ_CONTROL(geo_dash_dev.virtbase));
+		free_irq(geo_dash_dev.irq, &geo_dash_dev);
+		irq_dispose_mapping(geo_dash_dev.irq);
+	}
+out_unmap:
+	iounmap(geo_dash_dev.virtbase);
 out_release_mem_region:
 	release_mem_region(geo_dash_dev.res.start, resource_size(&geo_dash_dev.res));
-out_deregister:
-	misc_deregister(&geo_dash_misc_device);
 	return ret;
 }
 
 /* Clean-up code: release resources */
 static int geo_dash_remove(struct platform_device *pdev)
 {
+	/* Mirror probe: no new ioctl() or mmap() once the registers go */
+	misc_deregister(&geo_dash_misc_device);
+	debugfs_remove_recursive(geo_dash_dev.debugfs);
+	if (geo_dash_dev.irq) {
+		iowrite16(IRQ_VBLANK_ACK, IRQ_CONTROL(geo_dash_dev.virtbase));
+		free_irq(geo_dash_dev.irq, &geo_dash_dev);
+		irq_dispose_mapping(geo_dash_dev.irq);
+	}
 	iounmap(geo_dash_dev.virtbase);
 	release_mem_region(geo_dash_dev.res.start, resource_size(&geo_dash_dev.res));
-	misc_deregister(&geo_dash_misc_device);
 	return 0;
 }
 
@@ -18,6 +18,10 @@
 #define OBS_PLATFORM 3         // Platform (can land on)
 #define OBS_JUMP_PAD 4         // Jump pad (extra boost)
 #define OBS_GRAVITY_PORTAL 5   // Gravity portal (flip gravity)
+#define OBS_BLOCK_PLATFORM 6   // Block with a platform on top
+#define OBS_SHORT_SPIKE 7      // Short spike (instant death)
+#define OBS_RAZOR 8            // Razor blade (instant death)
+#define OBS_SLOPE 9            // Slope (can land on)
 
 // Player state flags
 #define PLAYER_NORMAL 0x00     // Default state
@@ -31,19 +35,74 @@
 #define GAME_PLAYING 0x04      // Game is in progress
 #define GAME_OVER 0x08         // Game is over
 
+// Register byte offsets within the player_sprite window (16-bit registers)
+#define REG_PLAYER_Y_POS       0x00
+#define REG_X_SHIFT            0x02
+#define REG_BACKGROUND_R       0x04
+#define REG_BACKGROUND_G       0x06
+#define REG_BACKGROUND_B       0x08
+#define REG_MAP_BLOCK          0x0A
+#define REG_FLAGS              0x0C
+#define REG_OUTPUT_FLAGS       0x0E
+#define REG_IRQ_CONTROL        0x10
+#define REG_TILE_COLUMN        0x12
+#define REG_BACKGROUND_BOTTOM_R 0x14
+#define REG_BACKGROUND_BOTTOM_G 0x16
+#define REG_BACKGROUND_BOTTOM_B 0x18
+
+// The tile layer's map: one obstacle code per column, 32 pixels wide each
+#define TILE_COLUMNS           32
+#define TILE_SCREEN_COLUMNS    20     // Columns across the 640-pixel screen
+#define TILE_COLUMN_SHIFT      8      // REG_TILE_COLUMN: column << 8 | code
+#define TILE_SCROLL_MASK       0x3FF  // REG_X_SHIFT: pixel (4:0), column (9:5)
+
+// Bits written to REG_IRQ_CONTROL
+#define IRQ_VBLANK_ENABLE      0x01   // Raise an IRQ at the start of vblank
+#define IRQ_VBLANK_ACK         0x02   // Clear the pending vblank IRQ
+
 // Structure for communicating with the device driver
 typedef struct {
-    uint16_t x_shift;          // Pixel offset for scrolling
+    uint16_t x_shift;          // Tile layer scroll, TILE_SCROLL_MASK bits
     uint16_t player_y;         // Player Y position
-    uint8_t  bg_r;             // Background color (R)
-    uint8_t  bg_g;             // Background color (G)
-    uint8_t  bg_b;             // Background color (B)
+    uint8_t  bg_r;             // Background color at the top (R)
+    uint8_t  bg_g;             // Background color at the top (G)
+    uint8_t  bg_b;             // Background color at the top (B)
+    uint8_t  bg_bottom_r;      // Background color at the bottom (R)
+    uint8_t  bg_bottom_g;      // Background color at the bottom (G)
+    uint8_t  bg_bottom_b;      // Background color at the bottom (B)
     uint8_t  map_block;        // Current map block
     uint8_t  flags;            // Game flags
     uint8_t  output_flags;     // Output status flags
     uint32_t audio;            // Audio sample
 } geo_dash_arg_t;
 
+// Dirty-field mask for WRITE_FRAME: one bit per register
+#define DIRTY_PLAYER_Y         0x01
+#define DIRTY_X_SHIFT          0x02
+#define DIRTY_BACKGROUND_R     0x04
+#define DIRTY_BACKGROUND_G     0x08
+#define DIRTY_BACKGROUND_B     0x10
+#define DIRTY_MAP_BLOCK        0x20
+#define DIRTY_FLAGS            0x40
+#define DIRTY_OUTPUT_FLAGS     0x80
+#define DIRTY_BACKGROUND_BOTTOM_R 0x100
+#define DIRTY_BACKGROUND_BOTTOM_G 0x200
+#define DIRTY_BACKGROUND_BOTTOM_B 0x400
+#define DIRTY_ALL              0x7FF
+
+// A whole frame of register state; only fields named in dirty are written
+typedef struct {
+    geo_dash_arg_t regs;
+    uint32_t dirty;
+} geo_dash_frame_t;
+
+// Obstacle codes for count tile columns from first, for WRITE_TILE_COLUMNS
+typedef struct {
+    uint8_t first;             // First tile column
+    uint8_t count;             // Columns in codes, at most TILE_COLUMNS
+    uint8_t codes[TILE_COLUMNS];
+} geo_dash_columns_t;
+
 // IOCTL commands
 #define GEO_DASH_MAGIC 'q'
 
@@ -55,6 +114,13 @@ typedef struct {
 #define WRITE_MAP_BLOCK        _IOW(GEO_DASH_MAGIC, 5, geo_dash_arg_t *)
 #define WRITE_FLAGS            _IOW(GEO_DASH_MAGIC, 6, geo_dash_arg_t *)
 #define WRITE_OUTPUT_FLAGS     _IOW(GEO_DASH_MAGIC, 7, geo_dash_arg_t *)
+#define WRITE_FRAME            _IOW(GEO_DASH_MAGIC, 8, geo_dash_frame_t *)
+#define READ_MMAP_OFFSET       _IOR(GEO_DASH_MAGIC, 9, uint32_t *)
+#define WAIT_VSYNC             _IOR(GEO_DASH_MAGIC, 10, uint32_t *)
+#define WRITE_TILE_COLUMNS     _IOW(GEO_DASH_MAGIC, 11, geo_dash_columns_t *)
+#define WRITE_BACKGROUND_BOTTOM_R _IOW(GEO_DASH_MAGIC, 12, geo_dash_arg_t *)
+#define WRITE_BACKGROUND_BOTTOM_G _IOW(GEO_DASH_MAGIC, 13, geo_dash_arg_t *)
+#define WRITE_BACKGROUND_BOTTOM_B _IOW(GEO_DASH_MAGIC, 14, geo_dash_arg_t *)
 
 
 
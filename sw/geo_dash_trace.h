@@ -0,0 +1,65 @@
+/*
+ * Tracepoints for the geo_dash driver
+ *
+ * Enable with
+ * echo 1 > /sys/kernel/tracing/events/geo_dash/enable
+ * and read /sys/kernel/tracing/trace_pipe.  Disabled tracepoints cost a
+ * single not-taken branch, unlike the printk()s they replace.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM geo_dash
+
+#if !defined(_GEO_DASH_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _GEO_DASH_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(geo_dash_ioctl,
+	TP_PROTO(unsigned int cmd, long ret, u64 ns),
+	TP_ARGS(cmd, ret, ns),
+	TP_STRUCT__entry(
+		__field(unsigned int, cmd)
+		__field(long, ret)
+		__field(u64, ns)
+	),
+	TP_fast_assign(
+		__entry->cmd = cmd;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+	TP_printk("cmd=0x%x ret=%ld ns=%llu", __entry->cmd, __entry->ret, __entry->ns)
+);
+
+TRACE_EVENT(geo_dash_frame,
+	TP_PROTO(u32 dirty),
+	TP_ARGS(dirty),
+	TP_STRUCT__entry(
+		__field(u32, dirty)
+	),
+	TP_fast_assign(
+		__entry->dirty = dirty;
+	),
+	TP_printk("dirty=0x%03x", __entry->dirty)
+);
+
+TRACE_EVENT(geo_dash_vblank,
+	TP_PROTO(u32 frame),
+	TP_ARGS(frame),
+	TP_STRUCT__entry(
+		__field(u32, frame)
+	),
+	TP_fast_assign(
+		__entry->frame = frame;
+	),
+	TP_printk("frame=%u", __entry->frame)
+);
+
+#endif /* _GEO_DASH_TRACE_H */
+
+/* This part must be outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE geo_dash_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "geo_dash.h"
+#include "level_format.h"
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+// FNV-1a over a level's columns
+static uint32_t checksum_column(uint32_t hash, uint8_t column) {
+    return (hash ^ column) * 16777619u;
+}
+
+// Append a column to (obstacle, count) pairs; returns the new pair count
+static uint32_t append_column(uint8_t* runs, uint32_t count, uint8_t column) {
+    if (count > 0 && runs[2 * count - 2] == column && runs[2 * count - 1] < LEVEL_FILE_MAX_RUN) {
+        runs[2 * count - 1]++;
+        return count;
+    }
+    runs[2 * count] = column;
+    runs[2 * count + 1] = 1;
+    return count + 1;
+}
+
+// Write a level in the binary format
+int level_file_save(const char* filename, const uint8_t* level, int length, uint64_t seed) {
+    uint8_t header[LEVEL_FILE_HEADER_BYTES + LEVEL_SECTIONS * LEVEL_FILE_SECTION_BYTES];
+    uint8_t* runs = malloc(2 * length + 2);
+    uint32_t run_count = 0;
+    uint32_t checksum = 2166136261u;
+    FILE* out;
+
+    if (!runs) {
+        return -1;
+    }
+    for (int i = 0; i < length; i++) {
+        run_count = append_column(runs, run_count, level[i]);
+        checksum = checksum_column(checksum, level[i]);
+    }
+
+    put32(header, LEVEL_FILE_MAGIC);
+    put16(header + 4, LEVEL_FILE_VERSION);
+    put16(header + 6, LEVEL_SECTIONS);
+    put32(header + 8, seed);
+    put32(header + 12, seed >> 32);
+    put32(header + 16, length);
+    put32(header + 20, run_count);
+    put32(header + 24, checksum);
+    put32(header + 28, sizeof(header));
+
+    // The generator's difficulty table, sections splitting the level evenly
+    for (int i = 0; i < LEVEL_SECTIONS; i++) {
+        const DifficultySettings* d = level_difficulty(i);
+        uint8_t* p = header + LEVEL_FILE_HEADER_BYTES + i * LEVEL_FILE_SECTION_BYTES;
+        put32(p, i * (length / LEVEL_SECTIONS));
+        p[4] = d->spike_chance;
+        p[5] = d->block_chance;
+        p[6] = d->platform_chance;
+        p[7] = d->jump_pad_chance;
+        p[8] = d->portal_chance;
+        p[9] = d->min_gap;
+        p[10] = d->max_gap;
+        p[11] = 0;
+    }
+
+    out = fopen(filename, "wb");
+    if (!out) {
+        free(runs);
+        return -1;
+    }
+    if (fwrite(header, sizeof(header), 1, out) != 1 ||
+        (run_count && fwrite(runs, 2 * run_count, 1, out) != 1)) {
+        fclose(out);
+        free(runs);
+        return -1;
+    }
+    free(runs);
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+// Check a mapped binary file and point file at its runs
+static int parse_binary(LevelFile* file, const uint8_t* data, size_t size) {
+    uint32_t offset;
+    uint32_t columns = 0;
+
+    if (size < LEVEL_FILE_HEADER_BYTES || get16(data + 4) != LEVEL_FILE_VERSION) {
+        return -1;
+    }
+    file->section_count = get16(data + 6);
+    file->seed = get32(data + 8) | (uint64_t)get32(data + 12) << 32;
+    file->length = get32(data + 16);
+    file->run_count = get32(data + 20);
+    file->checksum = get32(data + 24);
+    offset = get32(data + 28);
+
+    if (file->section_count > LEVEL_SECTIONS ||
+        offset < LEVEL_FILE_HEADER_BYTES + file->section_count * LEVEL_FILE_SECTION_BYTES ||
+        offset > size || file->run_count > (size - offset) / 2) {
+        return -1;
+    }
+
+    for (int i = 0; i < file->section_count; i++) {
+        const uint8_t* p = data + LEVEL_FILE_HEADER_BYTES + i * LEVEL_FILE_SECTION_BYTES;
+        file->sections[i].start = get32(p);
+        file->sections[i].difficulty = (DifficultySettings){
+            .spike_chance = p[4],
+            .block_chance = p[5],
+            .platform_chance = p[6],
+            .jump_pad_chance = p[7],
+            .portal_chance = p[8],
+            .min_gap = p[9],
+            .max_gap = p[10],
+        };
+    }
+
+    // The reader trusts the runs to cover exactly length columns
+    file->runs = data + offset;
+    for (uint32_t i = 0; i < file->run_count; i++) {
+        if (file->runs[2 * i + 1] == 0) {
+            return -1;
+        }
+        columns += file->runs[2 * i + 1];
+    }
+    return columns == file->length ? 0 : -1;
+}
+
+// Import the text format: one number per line, as save_level_to_file() writes
+static int import_text(LevelFile* file, const char* text, size_t size) {
+    // Every column but the last takes at least two characters
+    uint8_t* runs = malloc(size + 2);
+    uint32_t checksum = 2166136261u;
+    size_t i = 0;
+
+    if (!runs) {
+        return -1;
+    }
+    file->length = 0;
+    file->run_count = 0;
+    while (1) {
+        int value = 0;
+        size_t digits = 0;
+
+        while (i < size && (text[i] == ' ' || text[i] == '\n' || text[i] == '\r' || text[i] == '\t')) {
+            i++;
+        }
+        while (i < size && text[i] >= '0' && text[i] <= '9') {
+            value = value * 10 + (text[i++] - '0');
+            digits++;
+        }
+        if (digits == 0) {
+            break; // End of the numbers, as fscanf() would stop
+        }
+        file->run_count = append_column(runs, file->run_count, (uint8_t)value);
+        checksum = checksum_column(checksum, (uint8_t)value);
+        file->length++;
+    }
+
+    file->imported = runs;
+    file->runs = runs;
+    file->checksum = checksum;
+    return 0;
+}
+
+// Map a binary level, or import the text format
+int level_file_open(LevelFile* file, const char* filename) {
+    struct stat st;
+    void* map = NULL;
+    int fd;
+    int result;
+
+    memset(file, 0, sizeof(*file));
+    fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+
+    if (st.st_size >= 4 && get32(map) == LEVEL_FILE_MAGIC) {
+        // Binary: keep the mapping, the runs are decoded straight from it
+        file->map = map;
+        file->map_size = st.st_size;
+        result = parse_binary(file, map, st.st_size);
+        if (result == -1) {
+            level_file_close(file);
+            errno = EINVAL;
+        }
+        return result;
+    }
+
+    // Text: parse it into runs once, then drop the mapping
+    result = import_text(file, map, st.st_size);
+    if (map) {
+        munmap(map, st.st_size);
+    }
+    return result;
+}
+
+// Decode every column against the checksum
+int level_file_check(const LevelFile* file) {
+    uint32_t hash = 2166136261u;
+
+    for (uint32_t i = 0; i < file->run_count; i++) {
+        for (int n = 0; n < file->runs[2 * i + 1]; n++) {
+            hash = checksum_column(hash, file->runs[2 * i]);
+        }
+    }
+    return hash == file->checksum;
+}
+
+void level_file_close(LevelFile* file) {
+    if (file->map) {
+        munmap(file->map, file->map_size);
+    }
+    free(file->imported);
+    memset(file, 0, sizeof(*file));
+}
+
+// Start decoding at column 0
+void level_reader_init(LevelReader* reader, const LevelFile* file) {
+    reader->file = file;
+    reader->run = 0;
+    reader->start = 0;
+}
+
+// Obstacle at a column, OBS_NONE past the end
+uint8_t level_reader_column(LevelReader* reader, uint32_t column) {
+    const uint8_t* runs = reader->file->runs;
+
+    if (column >= reader->file->length) {
+        return OBS_NONE;
+    }
+    if (column < reader->start) {
+        // Going backwards: decode again from the top
+        reader->run = 0;
+        reader->start = 0;
+    }
+    while (column >= reader->start + runs[2 * reader->run + 1]) {
+        reader->start += runs[2 * reader->run + 1];
+        reader->run++;
+    }
+    return runs[2 * reader->run];
+}
+
+#ifdef TEST_LEVEL_FORMAT
+#include <time.h>
+
+#define TEST_LOADS 10000
+
+static double seconds_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Open a level and decode every column, as the game would over a run
+static double time_loads(const char* filename, uint8_t* level) {
+    struct timespec start;
+    LevelFile file;
+    LevelReader reader;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < TEST_LOADS; n++) {
+        if (level_file_open(&file, filename) == -1) {
+            perror(filename);
+            exit(1);
+        }
+        level_reader_init(&reader, &file);
+        for (uint32_t i = 0; i < file.length; i++) {
+            level[i] = level_reader_column(&reader, i);
+        }
+        level_file_close(&file);
+    }
+    return seconds_since(&start) / TEST_LOADS;
+}
+
+int main(int argc, char* argv[]) {
+    uint8_t level[MAX_LEVEL_LENGTH];
+    uint8_t from_text[MAX_LEVEL_LENGTH];
+    uint8_t from_binary[MAX_LEVEL_LENGTH];
+    uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 0) : 1;
+    struct stat text_st, binary_st;
+
+    // Write one level in both formats
+    generate_level_seeded(level, MAX_LEVEL_LENGTH, seed);
+    save_level_to_file("level1.dat", level, MAX_LEVEL_LENGTH);
+    if (level_file_save("level1.gdl", level, MAX_LEVEL_LENGTH, seed) == -1) {
+        perror("level1.gdl");
+        return 1;
+    }
+    stat("level1.dat", &text_st);
+    stat("level1.gdl", &binary_st);
+
+    double text_s = time_loads("level1.dat", from_text);
+    double binary_s = time_loads("level1.gdl", from_binary);
+    printf("Text:   %6lld bytes, %6.2f us per load\n", (long long)text_st.st_size, text_s * 1e6);
+    printf("Binary: %6lld bytes, %6.2f us per load\n", (long long)binary_st.st_size, binary_s * 1e6);
+
+    int same = !memcmp(level, from_text, sizeof(level)) && !memcmp(level, from_binary, sizeof(level));
+    printf("Round trip %s\n", same ? "matches" : "DIFFERS");
+
+    // Change one obstacle in the runs: the file still parses, but its
+    // columns no longer match the checksum
+    LevelFile file;
+    FILE* f = fopen("level1.gdl", "rb");
+    uint8_t data[4096];
+    size_t size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    data[get32(data + 28)] ^= 1;
+    f = fopen("level1_bad.gdl", "wb");
+    fwrite(data, 1, size, f);
+    fclose(f);
+
+    int intact = level_file_open(&file, "level1.gdl") == 0 && level_file_check(&file);
+    level_file_close(&file);
+    int caught = level_file_open(&file, "level1_bad.gdl") == 0 && !level_file_check(&file);
+    level_file_close(&file);
+    printf("Checksum: intact file %s, corrupted file %s\n",
+           intact ? "passes" : "FAILS", caught ? "rejected" : "ACCEPTED");
+    return same && intact && caught ? 0 : 1;
+}
+#endif
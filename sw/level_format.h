@@ -0,0 +1,72 @@
+#ifndef _LEVEL_FORMAT_H
+#define _LEVEL_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "level_generator.h"
+
+// Binary level file, all fields little-endian:
+//
+//   0  magic "GDLV"          4  version        6  section count
+//   8  generator seed       16  length (columns)
+//  20  run count            24  FNV-1a of the decoded columns
+//  28  offset of the runs   32  sections, LEVEL_FILE_SECTION_BYTES each
+//
+// A section is its first column (4 bytes) and the seven DifficultySettings
+// fields as bytes.  The runs are (obstacle, count) byte pairs; most of a
+// level is OBS_NONE, so a 1024-column level takes a few hundred bytes.
+#define LEVEL_FILE_MAGIC 0x564C4447u  // "GDLV" as a little-endian word
+#define LEVEL_FILE_VERSION 1
+#define LEVEL_FILE_HEADER_BYTES 32
+#define LEVEL_FILE_SECTION_BYTES 12
+#define LEVEL_FILE_MAX_RUN 255        // Longest run one pair can hold
+
+// One difficulty section as stored in the header
+typedef struct {
+    uint32_t start;                   // First column of the section
+    DifficultySettings difficulty;
+} LevelSection;
+
+// An opened level: a read-only mapping of a binary file, or a text file
+// imported into the same run form in memory
+typedef struct {
+    uint64_t seed;                    // Generator seed, 0 if unknown
+    uint32_t length;                  // Columns in the level
+    uint32_t checksum;                // FNV-1a of the decoded columns
+    int section_count;
+    LevelSection sections[LEVEL_SECTIONS];
+    const uint8_t* runs;              // (obstacle, count) pairs
+    uint32_t run_count;
+    void* map;                        // mmap()ed file, NULL for imported text
+    size_t map_size;
+    uint8_t* imported;                // Runs built from a text file
+} LevelFile;
+
+// Sequential decoder over a level's runs
+typedef struct {
+    const LevelFile* file;
+    uint32_t run;                     // Run holding column start
+    uint32_t start;                   // First column of that run
+} LevelReader;
+
+// Write a level in the binary format; returns 0, or -1 with errno set
+int level_file_save(const char* filename, const uint8_t* level, int length, uint64_t seed);
+
+// Map a binary level, or import the old one-number-per-line text format.
+// Only the header and run counts are checked; columns decode on demand.
+// Returns 0, or -1 with errno set
+int level_file_open(LevelFile* file, const char* filename);
+
+// Decode every column against the checksum; returns 1 if it matches
+int level_file_check(const LevelFile* file);
+
+void level_file_close(LevelFile* file);
+
+// Start decoding at column 0
+void level_reader_init(LevelReader* reader, const LevelFile* file);
+
+// Obstacle at a column, OBS_NONE past the end.  O(1) amortized when the
+// columns asked for only move forward, as they do while the level scrolls
+uint8_t level_reader_column(LevelReader* reader, uint32_t column);
+
+#endif // _LEVEL_FORMAT_H
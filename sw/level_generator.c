@@ -3,35 +3,22 @@
 #include <stdint.h>
 #include <time.h>
 #include "geo_dash.h"
+#include "level_generator.h"
+#include "level_verifier.h"
 
 // Level generation parameters
 #define MIN_GAP 5           // Minimum blocks between obstacles
 #define MAX_GAP 10          // Maximum blocks between obstacles
 #define LEVEL_HEIGHT 6      // Height of level in blocks
 #define STARTING_BLOCKS 15  // Number of empty blocks at start
-#define LEVEL_SECTIONS 5    // Number of difficulty sections
+#define VERIFY_RETRIES 8    // Redraws of an impossible section before it is left empty
 
-// Difficulty settings
-typedef struct {
-    int spike_chance;       // Chance of generating a spike (0-100)
-    int block_chance;       // Chance of generating a block (0-100)
-    int platform_chance;    // Chance of generating a platform (0-100)
-    int jump_pad_chance;    // Chance of generating a jump pad (0-100)
-    int portal_chance;      // Chance of generating a gravity portal (0-100)
-    int min_gap;            // Minimum gap between obstacles
-    int max_gap;            // Maximum gap between obstacles
-} DifficultySettings;
-
-// Level generator context
-typedef struct {
-    uint8_t* level_data;    // Buffer to store level data
-    int level_length;       // Length of level in blocks
-    int current_position;   // Current position in level
-    DifficultySettings difficulty; // Current difficulty settings
-} LevelGenerator;
+// PCG32 (XSH RR) parameters
+#define PCG_MULTIPLIER 6364136223846793005ULL
+#define PCG_INCREMENT 1442695040888963407ULL
 
 // Predefined difficulty settings
-DifficultySettings difficulties[LEVEL_SECTIONS] = {
+static const DifficultySettings difficulties[LEVEL_SECTIONS] = {
     // Easy (tutorial)
     {
         .spike_chance = 10,
@@ -84,15 +71,38 @@ DifficultySettings difficulties[LEVEL_SECTIONS] = {
     }
 };
 
+// Difficulty settings of one level section
+const DifficultySettings* level_difficulty(int section) {
+    return &difficulties[section];
+}
+
+// Next 32 random bits from the generator's own PCG32 stream
+static uint32_t next_random(LevelGenerator* generator) {
+    uint64_t state = generator->rng_state;
+    uint32_t xorshifted = ((state >> 18) ^ state) >> 27;
+    uint32_t rot = state >> 59;
+    
+    generator->rng_state = state * PCG_MULTIPLIER + PCG_INCREMENT;
+    return (xorshifted >> rot) | (xorshifted << (-rot & 31));
+}
+
+// Random number in [0, bound), by multiply-shift instead of a division
+static int random_below(LevelGenerator* generator, int bound) {
+    return (int)(((uint64_t)next_random(generator) * (uint32_t)bound) >> 32);
+}
+
 // Initialize the level generator
-void init_level_generator(LevelGenerator* generator, uint8_t* buffer, int max_length) {
+void init_level_generator(LevelGenerator* generator, uint8_t* buffer, int max_length, uint64_t seed) {
     generator->level_data = buffer;
     generator->level_length = max_length;
     generator->current_position = 0;
     generator->difficulty = difficulties[0]; // Start with easiest difficulty
     
-    // Seed random number generator
-    srand(time(NULL));
+    // Standard PCG32 seeding: step once, add the seed, step again
+    generator->rng_state = 0;
+    next_random(generator);
+    generator->rng_state += seed;
+    next_random(generator);
 }
 
 // Add empty space (gap) to the level
@@ -125,7 +135,7 @@ void add_random_obstacle(LevelGenerator* generator) {
     }
     
     // Select a random obstacle type
-    int rand_val = rand() % total_chance;
+    int rand_val = random_below(generator, total_chance);
     int cumulative = 0;
     
     // Determine which obstacle to add
@@ -157,8 +167,7 @@ void add_pattern(LevelGenerator* generator, int pattern_type) {
             break;
             
         case 2: // Block with platform on top
-            add_obstacle(generator, OBS_BLOCK);
-            // In a full implementation, we'd place a platform above the block
+            add_obstacle(generator, OBS_BLOCK_PLATFORM);
             break;
             
         case 3: // Alternating spikes and blocks
@@ -176,14 +185,33 @@ void add_pattern(LevelGenerator* generator, int pattern_type) {
     }
 }
 
-// Generate a complete level
-void generate_level(uint8_t* buffer, int level_length) {
+// Add one obstacle or pattern and the gap after it
+static void add_section(LevelGenerator* generator) {
+    // Decide whether to add a pattern or single obstacle (20% chance of pattern)
+    if (random_below(generator, 100) < 20) {
+        add_pattern(generator, random_below(generator, 4));
+    } else {
+        add_random_obstacle(generator);
+    }
+    
+    // Add a gap between obstacles
+    int gap_size = generator->difficulty.min_gap + 
+                  random_below(generator, generator->difficulty.max_gap - generator->difficulty.min_gap + 1);
+    add_empty_space(generator, gap_size);
+}
+
+// Generate a complete level.  With a verifier, a section that no input
+// sequence survives is rolled back and redrawn; returns the redraws, or -1
+// if the verifier ran out of memory
+static int generate(uint8_t* buffer, int level_length, uint64_t seed, LevelVerifier* verifier) {
     LevelGenerator generator;
+    VerifierMark mark = {0};
     int section_length = level_length / LEVEL_SECTIONS;
     int current_section = 0;
+    int redrawn = 0;
     
     // Initialize generator
-    init_level_generator(&generator, buffer, level_length);
+    init_level_generator(&generator, buffer, level_length, seed);
     
     // Start with empty space
     add_empty_space(&generator, STARTING_BLOCKS);
@@ -200,18 +228,174 @@ void generate_level(uint8_t* buffer, int level_length) {
             add_empty_space(&generator, generator.difficulty.max_gap);
         }
         
-        // Decide whether to add a pattern or single obstacle (20% chance of pattern)
-        if (rand() % 100 < 20) {
-            add_pattern(&generator, rand() % 4);
-        } else {
-            add_random_obstacle(&generator);
+        if (!verifier) {
+            add_section(&generator);
+            continue;
         }
         
-        // Add a gap between obstacles
-        int gap_size = generator.difficulty.min_gap + 
-                      rand() % (generator.difficulty.max_gap - generator.difficulty.min_gap + 1);
-        add_empty_space(&generator, gap_size);
+        // Search on from the last section; redraw this one while nobody survives it
+        int start = generator.current_position;
+        if (verifier_mark(verifier, &mark) == -1) {
+            redrawn = -1;
+            break;
+        }
+        for (int attempt = 0; ; attempt++) {
+            add_section(&generator);
+            int alive = verifier_advance(verifier, generator.current_position);
+            if (alive != 0) {
+                redrawn = alive == -1 ? -1 : redrawn;
+                break;
+            }
+            
+            redrawn++;
+            verifier_rollback(verifier, &mark);
+            generator.current_position = start;
+            if (attempt == VERIFY_RETRIES) {
+                // Out of luck: leave a gap, which anyone alive can cross
+                add_empty_space(&generator, generator.difficulty.max_gap);
+                verifier_advance(verifier, generator.current_position);
+                break;
+            }
+        }
+        if (redrawn == -1) {
+            break;
+        }
+    }
+    
+    verifier_mark_free(&mark);
+    return redrawn;
+}
+
+// Generate a complete level; the same seed always gives the same level
+void generate_level_seeded(uint8_t* buffer, int level_length, uint64_t seed) {
+    generate(buffer, level_length, seed, NULL);
+}
+
+// Generate a level that can be cleared; returns the sections redrawn
+int generate_level_verified(uint8_t* buffer, int level_length, uint64_t seed) {
+    LevelVerifier verifier;
+    int redrawn;
+    
+    if (verifier_init(&verifier, buffer, level_length, 0) == -1) {
+        return -1;
+    }
+    redrawn = generate(buffer, level_length, seed, &verifier);
+    verifier_free(&verifier);
+    return redrawn;
+}
+
+// Difficulty at a distance: a blend of the table's neighbouring entries,
+// then past the last one spikes and blocks keep getting more likely
+static void stream_difficulty(uint32_t column, DifficultySettings* d) {
+    uint32_t step = column / STREAM_RAMP_COLUMNS;
+    int t = column % STREAM_RAMP_COLUMNS;
+    
+    if (step < LEVEL_SECTIONS - 1) {
+        const DifficultySettings* a = &difficulties[step];
+        const DifficultySettings* b = &difficulties[step + 1];
+#define BLEND(field) d->field = a->field + (b->field - a->field) * t / STREAM_RAMP_COLUMNS
+        BLEND(spike_chance);
+        BLEND(block_chance);
+        BLEND(platform_chance);
+        BLEND(jump_pad_chance);
+        BLEND(portal_chance);
+        BLEND(min_gap);
+        BLEND(max_gap);
+#undef BLEND
+        return;
+    }
+    
+    int extra = 5 * (step - (LEVEL_SECTIONS - 1));
+    *d = difficulties[LEVEL_SECTIONS - 1];
+    d->spike_chance += extra < 30 ? extra : 30;
+    d->block_chance += extra < 20 ? extra : 20;
+}
+
+// Generate the next section into pending
+static void stream_section(LevelStream* stream) {
+    LevelGenerator* generator = &stream->generator;
+    uint32_t step = stream->planned / STREAM_RAMP_COLUMNS;
+    
+    generator->current_position = 0;
+    stream_difficulty(stream->planned, &generator->difficulty);
+    
+    // Add a "breather" gap when difficulty steps up
+    if (step != stream->ramp_step) {
+        stream->ramp_step = step;
+        add_empty_space(generator, generator->difficulty.max_gap);
+    }
+    add_section(generator);
+    
+    stream->pending_read = 0;
+    stream->planned += generator->current_position;
+}
+
+// Copy the next chunk of columns into the ring, generating sections as needed
+static void stream_chunk(LevelStream* stream) {
+    uint8_t* chunk = &stream->ring[stream->generated % STREAM_COLUMNS];
+    struct timespec start, end;
+    long long ns;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < STREAM_CHUNK; i++) {
+        if (stream->pending_read == stream->generator.current_position) {
+            stream_section(stream);
+        }
+        chunk[i] = stream->pending[stream->pending_read++];
+    }
+    stream->generated += STREAM_CHUNK;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    ns = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+    stream->chunks++;
+    stream->total_ns += ns;
+    if (ns > stream->max_ns) {
+        stream->max_ns = ns;
+    }
+}
+
+// Start an endless level and generate its first STREAM_AHEAD columns
+void level_stream_init(LevelStream* stream, uint64_t seed) {
+    LevelGenerator* generator = &stream->generator;
+    
+    init_level_generator(generator, stream->pending, STREAM_PENDING, seed);
+    stream->planned = 0;
+    stream->ramp_step = 0;
+    stream->generated = 0;
+    stream->chunks = 0;
+    stream->total_ns = 0;
+    stream->max_ns = 0;
+    stream->late = 0;
+    
+    // Start with empty space
+    add_empty_space(generator, STARTING_BLOCKS);
+    stream->pending_read = 0;
+    stream->planned = generator->current_position;
+    
+    while (stream->generated < STREAM_AHEAD) {
+        stream_chunk(stream);
+    }
+}
+
+// Generate at most one chunk, if fewer than STREAM_AHEAD columns are ready
+int level_stream_update(LevelStream* stream, uint32_t column) {
+    if (stream->generated >= column + STREAM_AHEAD) {
+        return 0;
     }
+    stream_chunk(stream);
+    return 1;
+}
+
+// Obstacle at a column
+uint8_t level_stream_column(LevelStream* stream, uint32_t column) {
+    while (column >= stream->generated) {
+        stream_chunk(stream);
+        stream->late++;
+    }
+    if (column + STREAM_COLUMNS < stream->generated) {
+        return OBS_NONE;
+    }
+    return stream->ring[column % STREAM_COLUMNS];
 }
 
 // Save level data to a file
@@ -249,15 +433,95 @@ int load_level_from_file(const char* filename, uint8_t* level_data, int max_leng
 
 // Example usage
 #ifdef TEST_LEVEL_GENERATOR
-int main() {
+#include <pthread.h>
+
+#define BATCH_LEVELS 4096   // Levels in the parallel reproducibility check
+#define BATCH_THREADS 4
+#define STREAM_LEVEL_COLUMNS 1000000 // Columns in the endless run (three days of play at 60 Hz)
+
+typedef struct {
+    uint64_t seed;          // Seed of level 0; level i uses seed + i
+    int first;              // Levels this worker generates
+    int count;
+    uint32_t* checksums;    // One per level, indexed from 0
+} BatchJob;
+
+// FNV-1a over one level
+static uint32_t level_checksum(const uint8_t* level, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ level[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void* batch_worker(void* arg) {
+    BatchJob* job = arg;
     uint8_t level[MAX_LEVEL_LENGTH];
     
+    for (int i = job->first; i < job->first + job->count; i++) {
+        generate_level_seeded(level, MAX_LEVEL_LENGTH, job->seed + i);
+        job->checksums[i] = level_checksum(level, MAX_LEVEL_LENGTH);
+    }
+    return NULL;
+}
+
+// Generate the batch on nthreads workers
+static void run_batch(uint64_t seed, int nthreads, uint32_t* checksums) {
+    pthread_t threads[BATCH_THREADS];
+    BatchJob jobs[BATCH_THREADS];
+    int per_thread = BATCH_LEVELS / nthreads;
+    
+    for (int t = 0; t < nthreads; t++) {
+        jobs[t] = (BatchJob){ seed, t * per_thread, per_thread, checksums };
+        pthread_create(&threads[t], NULL, batch_worker, &jobs[t]);
+    }
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    static uint32_t serial[BATCH_LEVELS], parallel[BATCH_LEVELS];
+    uint8_t level[MAX_LEVEL_LENGTH];
+    uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 0) : (uint64_t)time(NULL);
+    struct timespec start, end;
+    int mismatches = 0;
+    
     // Generate a level
-    generate_level(level, MAX_LEVEL_LENGTH);
+    generate_level_seeded(level, MAX_LEVEL_LENGTH, seed);
     
     // Save it to a file
     save_level_to_file("level1.dat", level, MAX_LEVEL_LENGTH);
     
-    return 0;
+    // The same seeds must give the same levels however the work is split
+    run_batch(seed, 1, serial);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_batch(seed, BATCH_THREADS, parallel);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (int i = 0; i < BATCH_LEVELS; i++) {
+        mismatches += serial[i] != parallel[i];
+    }
+    
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Seed %llu: %d levels on %d threads in %.3f s (%.0f levels/s), %d differ from serial\n",
+           (unsigned long long)seed, BATCH_LEVELS, BATCH_THREADS, seconds,
+           BATCH_LEVELS / seconds, mismatches);
+    
+    // An endless level far past any fixed length, one update per column
+    static LevelStream stream;
+    long long spikes = 0;
+    level_stream_init(&stream, seed);
+    for (uint32_t column = 0; column < STREAM_LEVEL_COLUMNS; column++) {
+        level_stream_update(&stream, column);
+        spikes += level_stream_column(&stream, column) == OBS_SPIKE;
+    }
+    printf("Endless: %d columns in %d bytes, %llu chunks, mean %lld ns, slowest %lld ns, "
+           "%u late, %.1f%% spikes\n",
+           STREAM_LEVEL_COLUMNS, (int)sizeof(stream), (unsigned long long)stream.chunks,
+           stream.total_ns / (long long)stream.chunks, stream.max_ns, stream.late,
+           100.0 * spikes / STREAM_LEVEL_COLUMNS);
+    
+    return mismatches || stream.late ? 1 : 0;
 }
-#endif 
\ No newline at end of file
+#endif
\ No newline at end of file
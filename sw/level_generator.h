@@ -3,8 +3,75 @@
 
 #include <stdint.h>
 
-// Generate a complete level
-void generate_level(uint8_t* buffer, int level_length);
+#define LEVEL_SECTIONS 5    // Number of difficulty sections
+
+// Endless levels
+#define STREAM_CHUNK 64             // Columns generated at a time
+#define STREAM_CHUNKS 4             // Chunks in the ring (power of two)
+#define STREAM_COLUMNS (STREAM_CHUNK * STREAM_CHUNKS)
+#define STREAM_AHEAD 128            // Columns kept ready past the window
+#define STREAM_PENDING 64           // Room for one section, breather included
+#define STREAM_RAMP_COLUMNS 256     // Columns per step of the difficulty table
+
+// Difficulty settings
+typedef struct {
+    int spike_chance;       // Chance of generating a spike (0-100)
+    int block_chance;       // Chance of generating a block (0-100)
+    int platform_chance;    // Chance of generating a platform (0-100)
+    int jump_pad_chance;    // Chance of generating a jump pad (0-100)
+    int portal_chance;      // Chance of generating a gravity portal (0-100)
+    int min_gap;            // Minimum gap between obstacles
+    int max_gap;            // Maximum gap between obstacles
+} DifficultySettings;
+
+// Level generator context
+typedef struct {
+    uint8_t* level_data;    // Buffer to store level data
+    int level_length;       // Length of level in blocks
+    int current_position;   // Current position in level
+    DifficultySettings difficulty; // Current difficulty settings
+    uint64_t rng_state;     // PCG32 state, private to this generator
+} LevelGenerator;
+
+// Endless level: sections are generated into pending, then copied a chunk
+// at a time into a ring a fixed distance ahead of the player.  Memory is
+// constant however far the player gets.
+typedef struct {
+    LevelGenerator generator;       // Writes one section at a time into pending
+    uint8_t pending[STREAM_PENDING]; // Last section generated
+    int pending_read;               // Next column of pending to hand out
+    uint32_t planned;               // Columns ever written to pending
+    uint32_t ramp_step;             // Difficulty step of the last section
+    uint8_t ring[STREAM_COLUMNS];   // Column c lives at ring[c % STREAM_COLUMNS]
+    uint32_t generated;             // Columns ever copied into the ring
+    uint64_t chunks;                // Chunks generated
+    long long total_ns;             // Time spent generating them
+    long long max_ns;               // Slowest chunk
+    uint32_t late;                  // Chunks generated because a column was needed at once
+} LevelStream;
+
+// Generate a complete level from a 64-bit seed.  Each call has its own
+// random stream, so levels are reproducible and safe to build on any thread
+void generate_level_seeded(uint8_t* buffer, int level_length, uint64_t seed);
+
+// Like generate_level_seeded(), but each section is checked with the level
+// verifier as it is written and redrawn if no input sequence survives it.
+// Returns the sections redrawn, or -1 if out of memory
+int generate_level_verified(uint8_t* buffer, int level_length, uint64_t seed);
+
+// Start an endless level and generate its first STREAM_AHEAD columns
+void level_stream_init(LevelStream* stream, uint64_t seed);
+
+// Generate at most one chunk, if fewer than STREAM_AHEAD columns are ready
+// past column; call once a frame.  Returns whether a chunk was generated
+int level_stream_update(LevelStream* stream, uint32_t column);
+
+// Obstacle at a column.  Columns not yet generated are generated at once
+// (and counted as late); columns already dropped from the ring are empty
+uint8_t level_stream_column(LevelStream* stream, uint32_t column);
+
+// Difficulty settings of one level section; sections split a level evenly
+const DifficultySettings* level_difficulty(int section);
 
 // Save level data to a file
 void save_level_to_file(const char* filename, uint8_t* level_data, int level_length);
@@ -0,0 +1,15 @@
+#include "level_grid.h"
+
+// The grid column each obstacle code stands for
+const GridColumn grid_columns[MAX_OBSTACLES] = {
+    [OBS_NONE] = 0,
+    [OBS_SPIKE] = GRID_CELL(OBS_SPIKE, 0),
+    [OBS_BLOCK] = GRID_CELL(OBS_BLOCK, 0),
+    [OBS_PLATFORM] = GRID_CELL(OBS_PLATFORM, 0),
+    [OBS_JUMP_PAD] = GRID_CELL(OBS_JUMP_PAD, 0),
+    [OBS_GRAVITY_PORTAL] = GRID_CELL(OBS_GRAVITY_PORTAL, 0),
+    [OBS_BLOCK_PLATFORM] = GRID_CELL(OBS_BLOCK, 0) | GRID_CELL(OBS_PLATFORM, 1),
+    [OBS_SHORT_SPIKE] = GRID_CELL(OBS_SHORT_SPIKE, 0),
+    [OBS_RAZOR] = GRID_CELL(OBS_RAZOR, 0),
+    [OBS_SLOPE] = GRID_CELL(OBS_SLOPE, 0),
+};
@@ -0,0 +1,32 @@
+#ifndef _LEVEL_GRID_H
+#define _LEVEL_GRID_H
+
+#include <stdint.h>
+#include "geo_dash.h"
+
+#define GRID_ROWS 6                   // Rows of the level, row 0 on the ground
+#define GRID_ROW_MASK ((1u << GRID_ROWS) - 1)
+#define GRID_LANE_BITS 6              // Bits each obstacle type gets in a column
+#define GRID_TYPES 10                 // Obstacle types with a lane, OBS_NONE to OBS_SLOPE
+
+// One level column as bit-planes: bit (type * GRID_LANE_BITS + row) is set
+// where an obstacle of that type sits.  All the types fit in one word, so
+// an empty column is a zero test and each obstacle in it is one set bit.
+typedef uint64_t GridColumn;
+
+#define GRID_CELL(type, row) ((GridColumn)1 << ((type) * GRID_LANE_BITS + (row)))
+
+// Rows holding one obstacle type
+static inline uint32_t grid_rows(GridColumn column, int type) {
+    return (column >> (type * GRID_LANE_BITS)) & GRID_ROW_MASK;
+}
+
+// Level data stays one byte per column; each obstacle code names a whole
+// column, so stacked codes such as OBS_BLOCK_PLATFORM cost nothing extra
+extern const GridColumn grid_columns[MAX_OBSTACLES];
+
+static inline GridColumn grid_column(uint8_t code) {
+    return grid_columns[code & (MAX_OBSTACLES - 1)];
+}
+
+#endif // _LEVEL_GRID_H
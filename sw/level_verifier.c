@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "geo_dash.h"
+#include "physics.h"
+#include "level_verifier.h"
+
+#define VERIFY_INITIAL_ENTRIES 256    // Layers rarely grow past this
+#define VERIFY_MAX_THREADS 16
+
+static uint32_t pack_state(const Player* player) {
+    return ((player->y_pos >> FIX_SHIFT) & 0x1FF) |
+           (player->arc & 0x7F) << 9 |
+           (player->is_jumping & 1) << 16 |
+           (player->gravity_direction < 0) << 17;
+}
+
+static void unpack_state(const LevelVerifier* verifier, uint32_t state, int tick, Player* player) {
+    player->rate = &verifier->rate;
+    player->x_pos = (int64_t)tick * verifier->rate.speed;
+    player->y_pos = (state & 0x1FF) << FIX_SHIFT;
+    player->arc = (state >> 9) & 0x7F;
+    player->is_jumping = (state >> 16) & 1;
+    player->is_dead = 0;
+    player->is_gravity_inverted = (state >> 17) & 1;
+    player->gravity_direction = player->is_gravity_inverted ? -1 : 1;
+}
+
+// Last column step tick (counting from 1) checks for collisions
+static int step_column(const LevelVerifier* verifier, int tick) {
+    return (tick * verifier->rate.speed + (PLAYER_X + PLAYER_BOX_X + PLAYER_BOX_W) * FIX_ONE - 1) >>
+           (FIX_SHIFT + BLOCK_SHIFT);
+}
+
+// Obstacle at a column, empty past the end as in the level window
+static uint8_t level_column(const LevelVerifier* verifier, int column) {
+    return column < verifier->level_length ? verifier->level[column] : OBS_NONE;
+}
+
+// Make room for entries states in frontier and next
+static int reserve_entries(LevelVerifier* verifier, int entries) {
+    int capacity = verifier->capacity;
+    VerifierEntry* frontier;
+    VerifierEntry* next;
+
+    if (entries <= capacity) {
+        return 0;
+    }
+    while (capacity < entries) {
+        capacity *= 2;
+    }
+    frontier = realloc(verifier->frontier, capacity * sizeof(*frontier));
+    if (!frontier) {
+        return -1;
+    }
+    verifier->frontier = frontier;
+    next = realloc(verifier->next, capacity * sizeof(*next));
+    if (!next) {
+        return -1;
+    }
+    verifier->next = next;
+    verifier->capacity = capacity;
+    return 0;
+}
+
+// Make room for count more trace nodes
+static int reserve_nodes(LevelVerifier* verifier, int count) {
+    int capacity = verifier->node_capacity;
+    VerifierNode* nodes;
+
+    if (verifier->node_count + count <= capacity) {
+        return 0;
+    }
+    while (capacity < verifier->node_count + count) {
+        capacity *= 2;
+    }
+    nodes = realloc(verifier->nodes, capacity * sizeof(*nodes));
+    if (!nodes) {
+        return -1;
+    }
+    verifier->nodes = nodes;
+    verifier->node_capacity = capacity;
+    return 0;
+}
+
+// Expand every live state by one physics step, with and without a press
+static int step(LevelVerifier* verifier) {
+    uint32_t generation = ++verifier->generation;
+    int count = 0;
+
+    if (reserve_entries(verifier, 2 * verifier->count) == -1) {
+        return -1;
+    }
+
+    for (int i = 0; i < verifier->count; i++) {
+        const VerifierEntry* from = &verifier->frontier[i];
+        Player base;
+
+        unpack_state(verifier, from->state, verifier->tick, &base);
+
+        // A press only does anything when the player can jump
+        for (int pressed = 0; pressed <= !base.is_jumping; pressed++) {
+            Player player = base;
+            uint32_t presses = from->presses + pressed;
+            GridColumn cells[PHYSICS_MAX_COLUMNS];
+            VerifierEntry* to;
+            uint32_t state;
+            int first, columns = 0;
+
+            physics_move(&player, pressed);
+            first = physics_first_column(&player);
+            for (int column = first; column <= physics_last_column(&player); column++) {
+                cells[columns++] = grid_column(level_column(verifier, column));
+            }
+            physics_collide(&player, first, cells, columns);
+            if (player.is_dead) {
+                continue;
+            }
+
+            // Merge with the same state reached earlier in this step
+            state = pack_state(&player);
+            if (verifier->seen[state] == generation) {
+                to = &verifier->next[verifier->slot[state]];
+                if (to->presses <= presses) {
+                    continue;
+                }
+            } else {
+                verifier->seen[state] = generation;
+                verifier->slot[state] = count;
+                to = &verifier->next[count++];
+                to->state = state;
+            }
+            to->presses = presses;
+            to->node = from->node;
+            to->pressed = pressed;
+        }
+    }
+
+    // Only now is each state's best parent final
+    if (verifier->nodes) {
+        if (reserve_nodes(verifier, count) == -1) {
+            return -1;
+        }
+        for (int i = 0; i < count; i++) {
+            VerifierEntry* entry = &verifier->next[i];
+            verifier->nodes[verifier->node_count] = (VerifierNode){ entry->node, entry->pressed };
+            entry->node = verifier->node_count++;
+        }
+    }
+
+    VerifierEntry* swap = verifier->frontier;
+    verifier->frontier = verifier->next;
+    verifier->next = swap;
+    verifier->count = count;
+    verifier->tick++;
+    if (count > verifier->peak) {
+        verifier->peak = count;
+    }
+    return 0;
+}
+
+// Start at the level's first step; trace keeps what verifier_trace() needs
+int verifier_init(LevelVerifier* verifier, const uint8_t* level, int level_length, int trace) {
+    Player start;
+
+    memset(verifier, 0, sizeof(*verifier));
+    verifier->level = level;
+    verifier->level_length = level_length;
+    verifier->capacity = VERIFY_INITIAL_ENTRIES;
+    verifier->frontier = malloc(verifier->capacity * sizeof(VerifierEntry));
+    verifier->next = malloc(verifier->capacity * sizeof(VerifierEntry));
+    verifier->seen = calloc(VERIFY_STATES, sizeof(uint32_t));
+    verifier->slot = malloc(VERIFY_STATES * sizeof(uint32_t));
+    if (trace) {
+        verifier->node_capacity = VERIFY_INITIAL_ENTRIES * 16;
+        verifier->nodes = malloc(verifier->node_capacity * sizeof(VerifierNode));
+    }
+    if (!verifier->frontier || !verifier->next || !verifier->seen || !verifier->slot ||
+        (trace && !verifier->nodes)) {
+        verifier_free(verifier);
+        return -1;
+    }
+
+    physics_rate_init(&verifier->rate, PHYSICS_HZ);
+    physics_reset(&start, &verifier->rate);
+    verifier->frontier[0] = (VerifierEntry){ pack_state(&start), 0, -1, 0 };
+    verifier->count = 1;
+    verifier->peak = 1;
+    return 0;
+}
+
+// Search every step whose column is before column; returns the states alive
+int verifier_advance(LevelVerifier* verifier, int column) {
+    while (verifier->count > 0 && step_column(verifier, verifier->tick + 1) < column) {
+        if (step(verifier) == -1) {
+            return -1;
+        }
+    }
+    return verifier->count;
+}
+
+// Save the search position
+int verifier_mark(const LevelVerifier* verifier, VerifierMark* mark) {
+    if (!mark->frontier || verifier->count > mark->capacity) {
+        VerifierEntry* frontier = realloc(mark->frontier, verifier->capacity * sizeof(*frontier));
+        if (!frontier) {
+            return -1;
+        }
+        mark->frontier = frontier;
+        mark->capacity = verifier->capacity;
+    }
+    memcpy(mark->frontier, verifier->frontier, verifier->count * sizeof(*mark->frontier));
+    mark->count = verifier->count;
+    mark->tick = verifier->tick;
+    mark->node_count = verifier->node_count;
+    return 0;
+}
+
+// Go back to a saved position; nodes past it are simply dropped
+void verifier_rollback(LevelVerifier* verifier, const VerifierMark* mark) {
+    // The frontier only grows, so it still has room for the saved one
+    memcpy(verifier->frontier, mark->frontier, mark->count * sizeof(*mark->frontier));
+    verifier->count = mark->count;
+    verifier->tick = mark->tick;
+    verifier->node_count = mark->node_count;
+}
+
+void verifier_mark_free(VerifierMark* mark) {
+    free(mark->frontier);
+    mark->frontier = NULL;
+    mark->capacity = 0;
+}
+
+// Button state per step along the path with fewest presses to the frontier
+int verifier_trace(const LevelVerifier* verifier, uint8_t* buttons, int max_ticks) {
+    const VerifierEntry* best = NULL;
+    int32_t node;
+
+    if (!verifier->nodes || verifier->count == 0 || verifier->tick > max_ticks) {
+        return -1;
+    }
+    for (int i = 0; i < verifier->count; i++) {
+        if (!best || verifier->frontier[i].presses < best->presses) {
+            best = &verifier->frontier[i];
+        }
+    }
+
+    node = best->node;
+    for (int tick = verifier->tick - 1; tick >= 0; tick--) {
+        buttons[tick] = verifier->nodes[node].pressed;
+        node = verifier->nodes[node].parent;
+    }
+    return verifier->tick;
+}
+
+void verifier_free(LevelVerifier* verifier) {
+    free(verifier->frontier);
+    free(verifier->next);
+    free(verifier->seen);
+    free(verifier->slot);
+    free(verifier->nodes);
+    memset(verifier, 0, sizeof(*verifier));
+}
+
+// Verify a whole level (buttons may be NULL)
+int verify_level(const uint8_t* level, int level_length, VerifyResult* result,
+                 uint8_t* buttons, int max_ticks) {
+    LevelVerifier verifier;
+
+    if (verifier_init(&verifier, level, level_length, buttons != NULL) == -1) {
+        return -1;
+    }
+    if (verifier_advance(&verifier, level_length) == -1) {
+        verifier_free(&verifier);
+        return -1;
+    }
+
+    result->beatable = verifier.count > 0;
+    result->ticks = verifier.tick;
+    result->presses = -1;
+    result->dead_column = result->beatable ? -1 : step_column(&verifier, verifier.tick);
+    result->peak_states = verifier.peak;
+    for (int i = 0; i < verifier.count; i++) {
+        if (result->presses == -1 || (int)verifier.frontier[i].presses < result->presses) {
+            result->presses = verifier.frontier[i].presses;
+        }
+    }
+    if (buttons) {
+        verifier_trace(&verifier, buttons, max_ticks);
+    }
+    verifier_free(&verifier);
+    return 0;
+}
+
+typedef struct {
+    const uint8_t* const* levels;
+    int level_length;
+    int count;
+    VerifyResult* results;
+    atomic_int next;          // Next level to hand out
+    atomic_int failed;        // Set if any worker ran out of memory
+} VerifyBatch;
+
+static void* verify_worker(void* arg) {
+    VerifyBatch* batch = arg;
+    int i;
+
+    // Take levels one at a time so slow ones do not hold up a thread's share
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+        if (verify_level(batch->levels[i], batch->level_length, &batch->results[i], NULL, 0) == -1) {
+            atomic_store(&batch->failed, 1);
+        }
+    }
+    return NULL;
+}
+
+// Verify many levels on worker threads
+int verify_levels(const uint8_t* const* levels, int level_length, int count,
+                  VerifyResult* results, int threads) {
+    pthread_t workers[VERIFY_MAX_THREADS];
+    VerifyBatch batch = { levels, level_length, count, results };
+    int started = 0;
+
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > VERIFY_MAX_THREADS) {
+        threads = VERIFY_MAX_THREADS;
+    }
+    atomic_init(&batch.next, 0);
+    atomic_init(&batch.failed, 0);
+
+    while (started < threads && pthread_create(&workers[started], NULL, verify_worker, &batch) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        verify_worker(&batch);
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    return atomic_load(&batch.failed) ? -1 : 0;
+}
+
+#ifdef TEST_LEVEL_VERIFIER
+#include <time.h>
+#include "level_generator.h"
+
+#define TEST_LEVELS 1024
+#define TEST_THREADS 4
+#define TEST_VERIFIED 16              // Verified levels that must need input
+
+int main(int argc, char* argv[]) {
+    static uint8_t levels[TEST_LEVELS][MAX_LEVEL_LENGTH];
+    static const uint8_t* pointers[TEST_LEVELS];
+    static VerifyResult results[TEST_LEVELS];
+    static uint8_t buttons[MAX_LEVEL_LENGTH * BLOCK_SIZE * PHYSICS_HZ / RUN_SPEED];
+    uint8_t trap[64] = {0};
+    uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 0) : 1;
+    struct timespec start, end;
+    VerifyResult result;
+    int beatable = 0;
+    int idle = 0;
+    long long presses = 0;
+
+    // Two triple spikes one column apart: no jump clears both
+    for (int i = 20; i < 23; i++) {
+        trap[i] = trap[i + 4] = OBS_SPIKE;
+    }
+    verify_level(trap, sizeof(trap), &result, NULL, 0);
+    printf("Trap level: %s, dead at column %d\n",
+           result.beatable ? "beatable" : "unbeatable", result.dead_column);
+
+    // A generated level with impossible sections redrawn, and its
+    // fewest-press route
+    int redrawn = generate_level_verified(levels[0], MAX_LEVEL_LENGTH, seed);
+    verify_level(levels[0], MAX_LEVEL_LENGTH, &result, buttons, sizeof(buttons));
+    printf("Seed %llu: %d sections redrawn, %s, %d steps, %d presses, peak %d states\n",
+           (unsigned long long)seed, redrawn, result.beatable ? "beatable" : "unbeatable",
+           result.ticks, result.presses, result.peak_states);
+    if (result.beatable) {
+        printf("Presses at steps:");
+        for (int t = 0; t < result.ticks; t++) {
+            if (buttons[t]) {
+                printf(" %d", t);
+            }
+        }
+        printf("\n");
+    }
+
+    // Verified levels must take presses: if the player could coast through,
+    // the verifier would be redrawing every hazard a jump cannot clear
+    for (int i = 0; i < TEST_VERIFIED; i++) {
+        generate_level_verified(levels[i], MAX_LEVEL_LENGTH, seed + i);
+        pointers[i] = levels[i];
+    }
+    if (verify_levels(pointers, MAX_LEVEL_LENGTH, TEST_VERIFIED, results, TEST_THREADS) == -1) {
+        fprintf(stderr, "Verification ran out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < TEST_VERIFIED; i++) {
+        idle += !results[i].beatable || results[i].presses == 0;
+    }
+    printf("%d verified levels: %d unbeatable or beaten without a press\n", TEST_VERIFIED, idle);
+    if (idle) {
+        return 1;
+    }
+
+    // A batch of unchecked levels across worker threads
+    for (int i = 0; i < TEST_LEVELS; i++) {
+        generate_level_seeded(levels[i], MAX_LEVEL_LENGTH, seed + i);
+        pointers[i] = levels[i];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (verify_levels(pointers, MAX_LEVEL_LENGTH, TEST_LEVELS, results, TEST_THREADS) == -1) {
+        fprintf(stderr, "Verification ran out of memory\n");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (int i = 0; i < TEST_LEVELS; i++) {
+        beatable += results[i].beatable;
+        presses += results[i].beatable ? results[i].presses : 0;
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%d levels on %d threads in %.3f s (%.0f levels/s): %d beatable, mean %.1f presses\n",
+           TEST_LEVELS, TEST_THREADS, seconds, TEST_LEVELS / seconds, beatable,
+           beatable ? (double)presses / beatable : 0.0);
+    return result.beatable ? 0 : 1;
+}
+#endif
@@ -0,0 +1,98 @@
+#ifndef _LEVEL_VERIFIER_H
+#define _LEVEL_VERIFIER_H
+
+#include <stdint.h>
+#include "physics.h"
+
+// A search state packs everything physics_move()/physics_collide() carry
+// from one step to the next except x, which follows from the step number:
+// y in pixels (9 bits), the arc step (7 bits), is_jumping and the gravity
+// direction.  The search runs at PHYSICS_HZ, where y is always a whole
+// pixel and the arc has 65 steps, and alive players stay within y
+// 0..OFF_SCREEN_Y, so the packing is exact.
+#define VERIFY_STATE_BITS 18
+#define VERIFY_STATES (1 << VERIFY_STATE_BITS)
+
+// One state alive after the current step
+typedef struct {
+    uint32_t state;           // Packed player state
+    uint32_t presses;         // Fewest presses that reach it
+    int32_t node;             // Its trace node, or its parent's while a step is built
+    uint8_t pressed;          // Whether the step into it pressed the button
+} VerifierEntry;
+
+// One step of a path through the search, for the input trace
+typedef struct {
+    int32_t parent;           // Node one step earlier, -1 before the first step
+    uint8_t pressed;
+} VerifierNode;
+
+// Breadth-first search over the states a level can put the player in,
+// one physics step per layer.  States reached twice in a step are merged,
+// keeping the path with fewer presses.  The search can stop at any column
+// and carry on later, and be rolled back, so a generator can check each
+// section as it writes it.
+typedef struct {
+    const uint8_t* level;
+    int level_length;
+    int tick;                 // Physics steps searched
+    VerifierEntry* frontier;  // States alive after tick steps
+    VerifierEntry* next;      // Layer being built
+    int count;                // Entries in frontier
+    int capacity;             // Entries allocated in frontier and next
+    uint32_t* seen;           // Per state: generation it was last reached in
+    uint32_t* slot;           // Per state: its index in next for that generation
+    uint32_t generation;      // Bumped every step, so seen never needs clearing
+    VerifierNode* nodes;      // Trace nodes, NULL without a trace
+    int node_count;
+    int node_capacity;
+    int peak;                 // Largest layer so far
+    PhysicsRate rate;         // The PHYSICS_HZ arc every state follows
+} LevelVerifier;
+
+// Search position saved by verifier_mark()
+typedef struct {
+    int tick;
+    int node_count;
+    VerifierEntry* frontier;
+    int count;
+    int capacity;
+} VerifierMark;
+
+// Outcome of verifying a whole level
+typedef struct {
+    int beatable;             // Whether any input sequence reaches the end
+    int ticks;                // Steps searched (to the end, or until all died)
+    int presses;              // Fewest presses that clear the level
+    int dead_column;          // Column where the last states died, -1 if beatable
+    int peak_states;          // Largest layer, a measure of search cost
+} VerifyResult;
+
+// Start at the level's first step; trace keeps what verifier_trace() needs.
+// Returns 0, or -1 if out of memory
+int verifier_init(LevelVerifier* verifier, const uint8_t* level, int level_length, int trace);
+
+// Search every step whose column is before column; returns the states
+// alive, or -1 if out of memory
+int verifier_advance(LevelVerifier* verifier, int column);
+
+// Save the search position, or go back to a saved one.  Return 0 or -1
+int verifier_mark(const LevelVerifier* verifier, VerifierMark* mark);
+void verifier_rollback(LevelVerifier* verifier, const VerifierMark* mark);
+void verifier_mark_free(VerifierMark* mark);
+
+// Button state per step along the path with fewest presses to the current
+// frontier, one byte per step; returns the steps written, -1 without a trace
+int verifier_trace(const LevelVerifier* verifier, uint8_t* buttons, int max_ticks);
+
+void verifier_free(LevelVerifier* verifier);
+
+// Verify a whole level (buttons may be NULL); returns 0, or -1 if out of memory
+int verify_level(const uint8_t* level, int level_length, VerifyResult* result,
+                 uint8_t* buttons, int max_ticks);
+
+// Verify many levels on worker threads; returns 0, or -1 on failure
+int verify_levels(const uint8_t* const* levels, int level_length, int count,
+                  VerifyResult* results, int threads);
+
+#endif // _LEVEL_VERIFIER_H
@@ -0,0 +1,82 @@
+#include "level_window.h"
+
+// Column from the source level, empty past its end
+static uint8_t source_column(const LevelWindow* window, int column) {
+    if (window->stream) {
+        return level_stream_column(window->stream, column);
+    }
+    if (window->reader) {
+        return level_reader_column(window->reader, column);
+    }
+    if (column < window->level_length) {
+        return window->level[column];
+    }
+    return OBS_NONE;
+}
+
+// Load the first WINDOW_SIZE columns from the source
+static void fill_window(LevelWindow* window) {
+    window->head = 0;
+    window->tail = 0;
+    window->next_obstacle = 0;
+
+    while (window->tail < WINDOW_SIZE) {
+        uint8_t code = source_column(window, window->tail);
+        window->cols[window->tail & WINDOW_MASK] = code;
+        window->cells[window->tail & WINDOW_MASK] = grid_column(code);
+        window->tail++;
+    }
+}
+
+// Fill the window with the first WINDOW_SIZE columns of a level
+void window_init(LevelWindow* window, const uint8_t* level, int level_length) {
+    window->level = level;
+    window->level_length = level_length;
+    window->reader = NULL;
+    window->stream = NULL;
+    fill_window(window);
+}
+
+// The same, pulling columns from a level file's reader instead
+void window_init_reader(LevelWindow* window, LevelReader* reader) {
+    window->level = NULL;
+    window->level_length = reader->file->length;
+    window->reader = reader;
+    window->stream = NULL;
+    fill_window(window);
+}
+
+// The same, pulling columns from an endless level
+void window_init_stream(LevelWindow* window, LevelStream* stream) {
+    window->level = NULL;
+    window->level_length = 0;
+    window->reader = NULL;
+    window->stream = stream;
+    fill_window(window);
+}
+
+// Drop the oldest column and load the next one; returns the new column number
+int window_advance(LevelWindow* window) {
+    int column = window->tail;
+
+    // The new column reuses the slot the oldest one occupied
+    uint8_t code = source_column(window, column);
+
+    window->cols[column & WINDOW_MASK] = code;
+    window->cells[column & WINDOW_MASK] = grid_column(code);
+    window->head++;
+    window->tail++;
+    return column;
+}
+
+// First column at or after column holding an obstacle, or the tail
+int window_next_obstacle(LevelWindow* window, int column) {
+    if (window->next_obstacle < column) {
+        window->next_obstacle = column;
+    }
+    while (window->next_obstacle < window->tail &&
+           window->cells[window->next_obstacle & WINDOW_MASK] == 0) {
+        window->next_obstacle++;
+    }
+    return window->next_obstacle;
+}
@@ -0,0 +1,59 @@
+#ifndef _LEVEL_WINDOW_H
+#define _LEVEL_WINDOW_H
+
+#include <stdint.h>
+#include "geo_dash.h"
+#include "level_format.h"
+#include "level_generator.h"
+#include "level_grid.h"
+
+#define WINDOW_SIZE 128                // Columns held in the window (power of two)
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+
+// Ring buffer of level columns, addressed by absolute column number
+typedef struct {
+    const uint8_t* level;              // Level data the window views
+    LevelReader* reader;               // Or a level file decoded as it scrolls
+    LevelStream* stream;               // Or an endless level generated as it scrolls
+    int level_length;                  // Length of the level in blocks
+    uint8_t cols[WINDOW_SIZE];         // Column ring, slot = column & WINDOW_MASK
+    GridColumn cells[WINDOW_SIZE];     // The same columns as bit-planes, for collisions
+    int head;                          // Oldest column still in the window
+    int tail;                          // One past the newest column
+    int next_obstacle;                 // Broadphase cursor: no obstacle before it
+} LevelWindow;
+
+// Fill the window with the first WINDOW_SIZE columns of a level
+void window_init(LevelWindow* window, const uint8_t* level, int level_length);
+
+// The same, pulling columns from a level file's reader instead
+void window_init_reader(LevelWindow* window, LevelReader* reader);
+
+// The same, pulling columns from an endless level
+void window_init_stream(LevelWindow* window, LevelStream* stream);
+
+// Drop the oldest column and load the next one; returns the new column number
+int window_advance(LevelWindow* window);
+
+// First column at or after column holding an obstacle, or the window's
+// tail if none is loaded yet.  Amortized O(1) while column only grows, as
+// it does while the level scrolls: it skips each empty column once
+int window_next_obstacle(LevelWindow* window, int column);
+
+// Obstacle at an absolute column, OBS_NONE outside the window
+static inline uint8_t window_column(const LevelWindow* window, int column) {
+    if (column < window->head || column >= window->tail) {
+        return OBS_NONE;
+    }
+    return window->cols[column & WINDOW_MASK];
+}
+
+// Obstacle bit-planes at an absolute column, empty outside the window
+static inline GridColumn window_cell(const LevelWindow* window, int column) {
+    if (column < window->head || column >= window->tail) {
+        return 0;
+    }
+    return window->cells[column & WINDOW_MASK];
+}
+
+#endif // _LEVEL_WINDOW_H
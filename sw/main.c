@@ -1,169 +1,510 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
-#include <sys/ioctl.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdarg.h>
 #include "geo_dash.h"
 #include "level_generator.h"
+#include "physics.h"
+#include "level_window.h"
+#include "level_format.h"
+#include "audio_fifo.h"
+#include "audio_source.h"
+#include "mixer.h"
+#include "device.h"
+#include "replay.h"
 
 // Game states
-#define LOADING 2
-#define READY 4
-#define PLAYING 6
-#define GAME_OVER 8
+#define STATE_LOADING 2
+#define STATE_READY 4
+#define STATE_PLAYING 6
+#define STATE_GAME_OVER 8
 
 // Game constants
-#define GROUND_Y 220          // Ground position (higher number = lower on screen)
-#define PLAYER_SPEED 2        // Horizontal movement speed
-#define JUMP_VELOCITY 10      // Initial jump velocity
-#define GRAVITY 1             // Gravity acceleration
-#define BLOCK_SIZE 32         // Size of a block in pixels
 #define SCREEN_COLS 20        // Number of columns on screen
 #define DISPLAY_HEIGHT 6      // Height of level in blocks
-#define DISPLAY_WIDTH 128     // Width of level buffer
-#define PLAYER_X 80           // Fixed player X position on screen
 #define LEVEL_LENGTH 1024     // Length of the level in blocks
 
+// Simulation loop constants
+#define MAX_CATCHUP_NS 133000000LL // Catch-up limit before simulation time is dropped:
+                                   // 8 steps at 60 Hz, the same time at any rate
+#define MAX_FRAME_NS 250000000LL  // Longest stall fed to the accumulator (250 ms)
+
+// Audio constants
+#define MUSIC_FILE "monody_stereo_48k.raw"
+#define MUSIC_GAIN (GAIN_UNITY / 2)   // Leave headroom for the effects
+#define EFFECT_GAIN GAIN_UNITY
+#define AUDIO_QUEUE_FRAMES (AUDIO_FIFO_DEPTH + 2 * MIXER_BLOCK_FRAMES) // Most audio queued ahead (21 ms)
+
 typedef struct {
-    int x_pos;                // Position in the level (pixels)
-    int y_pos;                // Position on screen (pixels)
-    int y_vel;                // Vertical velocity (pixels/frame)
-    int is_jumping;           // Whether player is jumping
-    int is_dead;              // Whether player is dead
-    int is_gravity_inverted;  // Whether gravity is inverted
-} Player;
+    int steps;                // Physics steps run this frame
+    long long sim_ns;         // Time spent in physics this frame
+    int skipped;              // Whether this frame dropped simulation time
+    long long total_steps;    // Physics steps since the game started
+    long long total_frames;   // Frames since the game started
+    long long frames_skipped; // Frames that hit the catch-up limit
+    long long max_sim_ns;     // Slowest frame's physics time
+} LoopStats;
 
 // Global variables
 Player player;
+PhysicsRate physics_rate;     // Arc table for physics_hz
 int button_pressed = 0;       // Input from button
 int x_shift = 0;              // Pixel shift for scrolling
 int level_position = 0;       // Current position in level
 int score = 0;                // Player score
-int fd;                       // File descriptor for device
-int gravity_direction = 1;    // 1 for normal, -1 for inverted
+geo_dash_arg_t shadow;        // Register state last sent to the hardware
+int shadow_valid = 0;         // Whether shadow reflects the hardware yet
+Device *device;               // Display and audio backend
+int headless = 0;             // Mock device, bot input, no console chatter
+int max_games = 0;            // Games to play before exiting, 0 = forever
+int games_played = 0;         // Games finished so far
+long long total_score = 0;    // Sum of final scores, for the headless report
+int physics_hz = PHYSICS_HZ;  // Physics steps per second
+long long step_ns;            // Length of one physics step
+long long accumulator = 0;    // Simulation time not yet stepped
+int prev_y_pos = GROUND_Y * FIX_ONE; // Player y before the last step, for interpolation (Q8)
+int render_alpha = 256;       // Position between previous and current step (Q8)
+int verbose = 0;              // Print per-frame loop counters
+LoopStats loop_stats;
+
+// Record and replay
+uint64_t base_seed;           // Level seed of the first game; game n uses base_seed + n
+uint64_t game_seed;           // Level seed of the current game
+const char *record_file = NULL; // Where each finished game's inputs are saved
+Replay recording;             // Inputs of the game in progress
+
+// Audio
+Mixer mixer;                       // Music and sound effect voices
+AudioSource music;                 // mmap()ed background track
+int audio_enabled = 0;             // Whether the mixer feeds the device
+int audio_threaded = 0;            // Whether a thread feeds it (else the game loop)
+pthread_t audio_thread;            // Renders and writes mixer blocks
+atomic_int audio_running;          // Cleared to stop the audio thread
 
 // Level data
 uint8_t level_buf[LEVEL_LENGTH];   // Level data buffer
-uint8_t disp_buf[DISPLAY_WIDTH];   // Display buffer
+LevelFile level_file;              // Level loaded with -l
+LevelReader level_reader;          // Decodes level_file as it scrolls
+int level_from_file = 0;           // Whether to play level_file instead of generating
+LevelStream level_stream;          // Endless level, generated as the player goes
+int endless = 0;                   // Whether to play level_stream
+uint64_t stream_chunks = 0;        // Chunks generated over all endless games
+long long stream_ns = 0;           // Time spent generating them
+long long stream_max_ns = 0;       // Slowest chunk over all endless games
+LevelWindow window;                // Columns around the player
+uint8_t map_block = OBS_NONE;      // Newest column sent to the hardware
 
 // Function prototypes
 int loadMapAndMusic(void);
 int runGamePhysics(void);
 void updateDisplay(void);
+void commitFrame(const geo_dash_arg_t *regs);
 int getUserInput(void);
+int botInput(int state);
+long long nowNs(void);
+void message(const char *fmt, ...);
+void simulateFrame(long long frame_ns);
+void stepGame(void);
+uint32_t stateHash(void);
+int replayGame(const char *filename);
 void startAudioPlayback(void);
+int startAudio(void);
+void stopAudio(void);
+void *audioThread(void *unused);
+int pumpAudio(void);
+void playSound(int voice);
 void copyNextColumn(void);
+void uploadTiles(int first, int count);
 void checkCollisions(void);
 void initializeGame(void);
+void generateLevel(uint64_t seed);
 void gameOver(void);
-void handleObstacleEffect(uint8_t obstacle_type);
+int levelComplete(void);
 
-int main() {
-    int current_state = LOADING;
+int main(int argc, char *argv[]) {
+    int current_state = STATE_LOADING;
+    int use_ioctl = 0;
+    int pending_press = 0;
+    int seed_set = 0;
+    const char *replay_file = NULL;
+    const char *save_file = NULL;
+    int opt;
+    long long last_ns;
+    long long start_ns;
+    
+    while ((opt = getopt(argc, argv, "eil:m:P:r:R:s:vw:")) != -1) {
+        switch (opt) {
+            case 'e':
+                endless = 1; // Generate the level forever, ahead of the player
+                break;
+            case 'i':
+                use_ioctl = 1; // Force the WRITE_FRAME ioctl backend
+                break;
+            case 'l':
+                // Play a level file (binary, or the old text format)
+                if (level_file_open(&level_file, optarg) == -1) {
+                    perror("Error loading level");
+                    return -1;
+                }
+                if (!level_file_check(&level_file)) {
+                    fprintf(stderr, "Error loading level: %s fails its checksum\n", optarg);
+                    level_file_close(&level_file);
+                    return -1;
+                }
+                level_from_file = 1;
+                break;
+            case 'm':
+                headless = 1; // Mock device: play this many games unattended
+                max_games = atoi(optarg);
+                break;
+            case 'P':
+                replay_file = optarg; // Replay a recorded game flat out and verify it
+                break;
+            case 'r':
+                physics_hz = atoi(optarg); // Physics tick rate in Hz
+                break;
+            case 'R':
+                record_file = optarg; // Save the inputs of each game as it ends
+                break;
+            case 's':
+                base_seed = strtoull(optarg, NULL, 0); // Fixed level seed
+                seed_set = 1;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'w':
+                save_file = optarg; // Write the generated level to a binary level file and exit
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-e] [-i] [-l level_file] [-m games] [-r physics_hz] [-s seed] [-R record_file] [-P replay_file] [-v] [-w level_file]\n", argv[0]);
+                return -1;
+        }
+    }
+    if (replay_file) {
+        return replayGame(replay_file);
+    }
+    if ((level_from_file || endless) && record_file) {
+        fprintf(stderr, "Replays regenerate the level from its seed; record a generated level\n");
+        return -1;
+    }
+    if (level_from_file && endless) {
+        fprintf(stderr, "Endless mode generates its own level\n");
+        return -1;
+    }
+    if (save_file) {
+        // The level a game with this seed would play, for -l to load
+        if (level_from_file || endless) {
+            fprintf(stderr, "Only a generated level of fixed length can be written\n");
+            return -1;
+        }
+        if (!seed_set) {
+            base_seed = time(NULL);
+        }
+        generateLevel(base_seed);
+        if (level_file_save(save_file, level_buf, LEVEL_LENGTH, base_seed) == -1) {
+            perror("Error writing level");
+            return -1;
+        }
+        printf("Level with seed %llu written to %s\n", (unsigned long long)base_seed, save_file);
+        return 0;
+    }
+    if (physics_hz < PHYSICS_MIN_HZ || physics_hz > PHYSICS_MAX_HZ) {
+        fprintf(stderr, "Physics rate must be %d to %d Hz\n", PHYSICS_MIN_HZ, PHYSICS_MAX_HZ);
+        return -1;
+    }
+    step_ns = 1000000000LL / physics_hz;
+    physics_rate_init(&physics_rate, physics_hz);
     
-    // Open the device file
-    fd = open("/dev/player_sprite_0", O_RDWR);
-    if (fd == -1) {
-        perror("Error opening device");
+    // Open the display and audio backend
+    device = headless ? device_open_mock() : device_open_hardware(use_ioctl);
+    if (!device) {
         return -1;
     }
     
-    // Seed random number generator
-    srand(time(NULL));
+    if (!startAudio()) {
+        message("Audio unavailable, running without sound\n");
+    }
+    
+    // Level seeds: fixed with -s, otherwise from the clock
+    if (!seed_set) {
+        base_seed = time(NULL);
+    }
     
     initializeGame();
+    last_ns = device->now_ns(device);
+    start_ns = nowNs();
     
-    while (1) {
-        // Get user input
-        button_pressed = getUserInput();
+    while (max_games == 0 || games_played < max_games) {
+        // Latch input until a physics step consumes it
+        pending_press |= headless ? botInput(current_state) : getUserInput();
+        button_pressed = pending_press;
+        
+        // Measure the frame, clamping long stalls
+        long long now = device->now_ns(device);
+        long long frame_ns = now - last_ns;
+        last_ns = now;
+        if (frame_ns > MAX_FRAME_NS) {
+            frame_ns = MAX_FRAME_NS;
+        }
         
         switch (current_state) {
-            case LOADING:
+            case STATE_LOADING:
                 if (loadMapAndMusic()) {
-                    current_state = READY;
-                    printf("Game ready! Press button to start.\n");
+                    current_state = STATE_READY;
+                    message("Game ready! Press button to start.\n");
                 }
                 break;
                 
-            case READY:
+            case STATE_READY:
                 if (button_pressed) {
-                    current_state = PLAYING;
+                    pending_press = 0;
+                    accumulator = 0;
+                    current_state = STATE_PLAYING;
                     startAudioPlayback();
-                    printf("Game started!\n");
+                    message("Game started!\n");
                 }
                 break;
                 
-            case PLAYING:
-                runGamePhysics();
-                checkCollisions();
+            case STATE_PLAYING:
+                // Step physics at a fixed rate, independent of the display
+                accumulator += frame_ns;
+                simulateFrame(frame_ns);
+                if (loop_stats.steps > 0) {
+                    pending_press = 0;
+                }
+                
+                // Keep the endless level a fixed distance ahead, one chunk at most
+                if (endless) {
+                    level_stream_update(&level_stream, window.tail);
+                }
                 updateDisplay();
                 
-                // Check if player died
-                if (player.is_dead) {
-                    current_state = GAME_OVER;
+                // Check if player died or cleared the level
+                if (player.is_dead || levelComplete()) {
+                    current_state = STATE_GAME_OVER;
                     gameOver();
                 }
-                
-                // Increment score based on distance traveled
-                score += PLAYER_SPEED;
                 break;
                 
-            case GAME_OVER:
+            case STATE_GAME_OVER:
+                pending_press = 0;
                 if (button_pressed) {
                     // Reset game
                     initializeGame();
-                    current_state = READY;
-                    printf("Game reset! Press button to start.\n");
+                    current_state = STATE_READY;
+                    message("Game reset! Press button to start.\n");
                 }
                 break;
         }
         
-        // Small delay to control game speed
-        usleep(16667); // ~60 FPS
+        // Without an audio thread, top up the audio queue once per frame
+        if (audio_enabled && !audio_threaded) {
+            pumpAudio();
+        }
+        
+        // Sleep until the next vertical blank
+        device->wait_vsync(device);
     }
     
-    close(fd);
+    if (headless) {
+        const MockState *mock = device_mock_state(device);
+        double seconds = (nowNs() - start_ns) / 1e9;
+        printf("%d games in %.3f s: %.1f games/s, %.0f frames/s, mean score %lld\n",
+               games_played, seconds, games_played / seconds,
+               mock->frame / seconds, total_score / (games_played ? games_played : 1));
+        printf("%llu frame commits, %llu register writes (%.2f per frame), %llu audio words\n",
+               (unsigned long long)mock->commits, (unsigned long long)mock->log_count,
+               (double)mock->log_count / (mock->frame ? mock->frame : 1),
+               (unsigned long long)mock->audio_words);
+        printf("%llu tile columns uploaded (%.2f per frame)\n",
+               (unsigned long long)mock->tile_writes,
+               (double)mock->tile_writes / (mock->frame ? mock->frame : 1));
+        if (endless) {
+            printf("%llu level chunks, mean %lld ns, slowest %lld ns\n",
+                   (unsigned long long)stream_chunks,
+                   stream_ns / (long long)(stream_chunks ? stream_chunks : 1), stream_max_ns);
+        }
+    }
+    
+    stopAudio();
+    device->close(device);
+    replay_free(&recording);
+    level_file_close(&level_file);
     return 0;
 }
 
+long long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void simulateFrame(long long frame_ns) {
+    // Run as many fixed physics steps as the accumulated time allows
+    long long start = nowNs();
+    LoopStats *st = &loop_stats;
+    
+    st->steps = 0;
+    st->skipped = 0;
+    while (accumulator >= step_ns && !player.is_dead && !levelComplete()) {
+        // Spiral-of-death guard: drop time we cannot catch up on
+        if (st->steps * step_ns > MAX_CATCHUP_NS) {
+            accumulator %= step_ns;
+            st->skipped = 1;
+            st->frames_skipped++;
+            break;
+        }
+        
+        stepGame();
+        accumulator -= step_ns;
+        st->steps++;
+    }
+    
+    // Draw between the last two physics states
+    render_alpha = player.is_dead || levelComplete() ? 256 : (int)((accumulator * 256) / step_ns);
+    
+    st->sim_ns = nowNs() - start;
+    if (st->sim_ns > st->max_sim_ns) {
+        st->max_sim_ns = st->sim_ns;
+    }
+    st->total_steps += st->steps;
+    st->total_frames++;
+    
+    if (verbose) {
+        printf("frame %lld: %d steps, %lld ns physics, %lld ns frame%s\n",
+               st->total_frames, st->steps, st->sim_ns, frame_ns,
+               st->skipped ? ", skipped" : "");
+    }
+}
+
+void stepGame() {
+    // One fixed physics step; a replay reruns exactly these
+    if (record_file && replay_record(&recording, button_pressed) == -1) {
+        fprintf(stderr, "Out of memory recording inputs, recording stopped\n");
+        record_file = NULL;
+    }
+    
+    prev_y_pos = player.y_pos;
+    int moved = runGamePhysics();
+    checkCollisions();
+    button_pressed = 0; // A press only affects the first step after it
+    
+    // Increment score based on distance traveled
+    score += moved;
+}
+
+uint32_t stateHash() {
+    // Everything the simulation carries from one step to the next
+    int32_t state[] = {
+        (int32_t)player.x_pos, (int32_t)(player.x_pos >> 32), player.y_pos, player.arc, player.is_jumping,
+        player.is_dead, player.is_gravity_inverted, x_shift, level_position,
+        score, player.gravity_direction, map_block,
+    };
+    return replay_hash(FNV_OFFSET, state, sizeof(state) / sizeof(state[0]));
+}
+
+int replayGame(const char *filename) {
+    // Feed recorded inputs back step by step, as fast as the CPU allows
+    Replay replay = {0};
+    long long start_ns;
+    double seconds;
+    uint32_t hash;
+    uint32_t tick;
+    
+    if (replay_load(&replay, filename) == -1) {
+        perror("Error loading replay");
+        return -1;
+    }
+    if (replay.physics_hz < PHYSICS_MIN_HZ || replay.physics_hz > PHYSICS_MAX_HZ) {
+        fprintf(stderr, "Replay physics rate %u Hz is out of range\n", replay.physics_hz);
+        replay_free(&replay);
+        return -1;
+    }
+    
+    // No pacing and no sound: the mock device only absorbs register writes
+    headless = 1;
+    device = device_open_mock();
+    physics_hz = replay.physics_hz;
+    step_ns = 1000000000LL / physics_hz;
+    physics_rate_init(&physics_rate, physics_hz);
+    base_seed = replay.seed;
+    initializeGame();
+    
+    start_ns = nowNs();
+    for (tick = 0; tick < replay.ticks && !player.is_dead && !levelComplete(); tick++) {
+        button_pressed = replay_button(&replay, tick);
+        stepGame();
+    }
+    seconds = (nowNs() - start_ns) / 1e9;
+    hash = stateHash();
+    
+    printf("Replayed %u of %u steps (seed %llu, %u Hz) in %.3f s: %.0f steps/s\n",
+           tick, replay.ticks, (unsigned long long)replay.seed, replay.physics_hz, seconds,
+           seconds > 0 ? tick / seconds : 0.0);
+    printf("Final state hash %08x, recorded %08x: %s\n", hash, replay.final_hash,
+           hash == replay.final_hash && tick == replay.ticks ? "match" : "MISMATCH");
+    
+    device->close(device);
+    replay_free(&replay);
+    return hash == replay.final_hash && tick == replay.ticks ? 0 : 1;
+}
+
 void initializeGame() {
     // Initialize player
-    player.x_pos = 0;
-    player.y_pos = GROUND_Y;
-    player.y_vel = 0;
-    player.is_jumping = 0;
-    player.is_dead = 0;
-    player.is_gravity_inverted = 0;
+    physics_reset(&player, &physics_rate);
     
     // Reset game variables
     x_shift = 0;
     level_position = 0;
     score = 0;
-    gravity_direction = 1;
+    prev_y_pos = player.y_pos;
+    render_alpha = 256;
+    accumulator = 0;
+    loop_stats = (LoopStats){0};
+    
+    // Play the loaded level, or generate a new one reproducible from its seed
+    if (endless) {
+        game_seed = base_seed + games_played;
+        level_stream_init(&level_stream, game_seed);
+        window_init_stream(&window, &level_stream);
+    } else if (level_from_file) {
+        game_seed = level_file.seed;
+        level_reader_init(&level_reader, &level_file);
+        window_init_reader(&window, &level_reader);
+    } else {
+        game_seed = base_seed + games_played;
+        generateLevel(game_seed);
+        window_init(&window, level_buf, LEVEL_LENGTH);
+    }
+    map_block = OBS_NONE;
+    uploadTiles(0, TILE_SCREEN_COLUMNS + 1);
     
-    // Generate a new level
-    generate_level(level_buf, LEVEL_LENGTH);
+    // Start recording this game's inputs
+    if (record_file) {
+        replay_init(&recording, game_seed, physics_hz);
+    }
     
     // Reset display
     updateDisplay();
 }
 
 int loadMapAndMusic() {
-    // Initialize display buffer
-    for (int i = 0; i < DISPLAY_WIDTH; i++) {
-        disp_buf[i] = level_buf[i];
-    }
-    
-    // Set the background to the initial color
-    geo_dash_arg_t arg;
+    // Set the background to the initial gradient
+    geo_dash_arg_t arg = shadow;
     arg.bg_r = 50;
     arg.bg_g = 100;
     arg.bg_b = 200;
-    ioctl(fd, WRITE_BACKGROUND_R, &arg);
-    ioctl(fd, WRITE_BACKGROUND_G, &arg);
-    ioctl(fd, WRITE_BACKGROUND_B, &arg);
+    arg.bg_bottom_r = 25;
+    arg.bg_bottom_g = 50;
+    arg.bg_bottom_b = 100;
+    commitFrame(&arg);
     
     return 1; // Successfully loaded
 }
@@ -190,164 +531,130 @@ int getUserInput() {
     return 0; // Button not pressed
 }
 
-int runGamePhysics() {
-    // Jump when button is pressed and player is on ground
-    if (button_pressed && !player.is_jumping) {
-        player.y_vel = -JUMP_VELOCITY * gravity_direction;
-        player.is_jumping = 1;
+int botInput(int state) {
+    // Headless player: start and restart at once, jump just before hazards
+    if (state != STATE_PLAYING) {
+        return 1;
     }
-    
-    // Apply gravity
-    player.y_vel += GRAVITY * gravity_direction;
-    
-    // Update player position
-    player.y_pos += player.y_vel;
-    
-    // Check if player has landed on ground (depends on gravity direction)
-    if (gravity_direction > 0) {
-        // Normal gravity
-        if (player.y_pos >= GROUND_Y) {
-            player.y_pos = GROUND_Y;
-            player.y_vel = 0;
-            player.is_jumping = 0;
-        }
-    } else {
-        // Inverted gravity
-        if (player.y_pos <= 50) { // Top of the screen
-            player.y_pos = 50;
-            player.y_vel = 0;
-            player.is_jumping = 0;
+    int column = physics_column(&player);
+    for (int ahead = 1; ahead <= 2; ahead++) {
+        GridColumn cell = window_cell(&window, column + ahead);
+        if (cell & (GRID_CELL(OBS_SPIKE, 0) | GRID_CELL(OBS_BLOCK, 0) |
+                    GRID_CELL(OBS_SHORT_SPIKE, 0) | GRID_CELL(OBS_RAZOR, 0))) {
+            return 1;
         }
     }
+    return 0;
+}
+
+void message(const char *fmt, ...) {
+    // Console output for a human player; headless runs stay quiet
+    va_list args;
     
-    // Move the level (player stays in fixed position)
-    player.x_pos += PLAYER_SPEED;
-    level_position += PLAYER_SPEED;
-    x_shift += PLAYER_SPEED;
+    if (headless) {
+        return;
+    }
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+int runGamePhysics() {
+    // Jump, fall and move forward by the shared physics rules
+    int64_t x = player.x_pos >> FIX_SHIFT;
+    if (physics_move(&player, button_pressed) & PHYS_JUMPED) {
+        playSound(VOICE_JUMP);
+    }
     
-    // If we've shifted by a full block, update the display buffer
-    if (x_shift >= BLOCK_SIZE) {
+    // Move the level by the whole pixels gained (player stays in fixed position)
+    int moved = (int)((player.x_pos >> FIX_SHIFT) - x);
+    level_position += moved;
+    x_shift += moved;
+    
+    // For every full block shifted, advance the level window
+    while (x_shift >= BLOCK_SIZE) {
         x_shift -= BLOCK_SIZE;
         copyNextColumn();
     }
     
-    return 1;
+    return moved;
 }
 
 void copyNextColumn() {
-    // Shift all columns left
-    for (int i = 0; i < DISPLAY_WIDTH - 1; i++) {
-        disp_buf[i] = disp_buf[i + 1];
-    }
+    // O(1): the ring drops its oldest column and loads the next one
+    int column = window_advance(&window);
     
-    // Add new column from level data
-    int next_block = level_position / BLOCK_SIZE + DISPLAY_WIDTH;
-    if (next_block < LEVEL_LENGTH) {
-        disp_buf[DISPLAY_WIDTH - 1] = level_buf[next_block];
-    } else {
-        disp_buf[DISPLAY_WIDTH - 1] = EMPTY; // End of level
-    }
+    // Only the newly exposed column goes to the hardware
+    map_block = window_column(&window, column);
+    
+    // The tile map is a ring the scroll register moves over, so only the
+    // column coming on at the right edge is uploaded
+    uploadTiles(window.head + TILE_SCREEN_COLUMNS, 1);
 }
 
-void handleObstacleEffect(uint8_t obstacle_type) {
-    switch (obstacle_type) {
-        case OBS_JUMP_PAD:
-            // Extra boost jump
-            player.y_vel = -JUMP_VELOCITY * 1.5 * gravity_direction;
-            player.is_jumping = 1;
-            break;
-            
-        case OBS_GRAVITY_PORTAL:
-            // Invert gravity
-            gravity_direction *= -1;
-            player.is_gravity_inverted = !player.is_gravity_inverted;
-            break;
+void uploadTiles(int first, int count) {
+    // Level column n lives in tile column n mod TILE_COLUMNS
+    uint8_t codes[TILE_COLUMNS];
+    
+    for (int i = 0; i < count; i++) {
+        codes[i] = window_column(&window, first + i);
     }
+    device->upload_columns(device, first, codes, count);
 }
 
 void checkCollisions() {
-    // Get the block at player's position
-    int player_block_x = (player.x_pos + PLAYER_X) / BLOCK_SIZE;
-    
-    // Check for collision with obstacles
-    if (player_block_x < DISPLAY_WIDTH) {
-        uint8_t block_type = disp_buf[player_block_x];
-        
-        switch (block_type) {
-            case OBS_SPIKE:
-                // Die on spike collision
-                if (player.y_pos + BLOCK_SIZE/2 > GROUND_Y - BLOCK_SIZE/2) {
-                    player.is_dead = 1;
-                    printf("Hit spike! Game over.\n");
-                }
-                break;
-                
-            case OBS_BLOCK:
-                // Die on block collision
-                if (player.y_pos + BLOCK_SIZE/2 > GROUND_Y - BLOCK_SIZE) {
-                    player.is_dead = 1;
-                    printf("Hit block! Game over.\n");
-                }
-                break;
-                
-            case OBS_PLATFORM:
-                // Land on platform if falling
-                if (gravity_direction > 0 && player.y_vel > 0 && 
-                    player.y_pos < GROUND_Y - BLOCK_SIZE) {
-                    player.y_pos = GROUND_Y - BLOCK_SIZE;
-                    player.y_vel = 0;
-                    player.is_jumping = 0;
-                }
-                break;
-                
-            case OBS_JUMP_PAD:
-            case OBS_GRAVITY_PORTAL:
-                // Handle special obstacles
-                handleObstacleEffect(block_type);
-                break;
+    // Check for collision with obstacles the player swept past this step
+    GridColumn cells[PHYSICS_MAX_COLUMNS];
+    int first = physics_first_column(&player);
+    int last = physics_last_column(&player);
+    int count = 0;
+    
+    // Broadphase: until the next obstacle, only the screen edges matter
+    if (window_next_obstacle(&window, first) <= last) {
+        for (int column = first; column <= last; column++) {
+            cells[count++] = window_cell(&window, column);
         }
     }
-    
-    // Check if player went off screen
-    if ((gravity_direction > 0 && player.y_pos < 0) ||
-        (gravity_direction < 0 && player.y_pos > 300)) {
-        player.is_dead = 1;
-        printf("Went off screen! Game over.\n");
-    }
+    int events = physics_collide(&player, first, cells, count);
+    
+    if (events & PHYS_JUMPED) playSound(VOICE_JUMP);
+    if (events & PHYS_PORTAL) playSound(VOICE_PORTAL);
+    if (events & PHYS_HIT_SPIKE) message("Hit spike! Game over.\n");
+    if (events & PHYS_HIT_BLOCK) message("Hit block! Game over.\n");
+    if (events & PHYS_HIT_RAZOR) message("Hit razor! Game over.\n");
+    if (events & PHYS_OFF_SCREEN) message("Went off screen! Game over.\n");
 }
 
 void updateDisplay() {
     // Update hardware with current game state
     geo_dash_arg_t arg;
     
-    // Update player position
-    arg.player_y = player.y_pos;
-    ioctl(fd, WRITE_PLAYER_Y_POS, &arg);
+    // Update player position, interpolated between physics steps
+    arg.player_y = (prev_y_pos + (((player.y_pos - prev_y_pos) * render_alpha) >> 8)) >> FIX_SHIFT;
     
-    // Update x shift for scrolling
-    arg.x_shift = x_shift;
-    ioctl(fd, WRITE_X_SHIFT, &arg);
+    // Scroll the tile layer to the level position, wrapping with its ring
+    arg.x_shift = level_position & TILE_SCROLL_MASK;
     
-    // Update map block (assuming this controls which part of the level is shown)
-    arg.map_block = level_position / BLOCK_SIZE;
-    ioctl(fd, WRITE_MAP_BLOCK, &arg);
+    // Update map block with the newest column of the level window
+    arg.map_block = map_block;
     
-    // Set background color based on current section of the level
-    // This creates a nice color transition as the player progresses
-    int level_progress = (level_position * 100) / (LEVEL_LENGTH * BLOCK_SIZE);
+    // Set the background gradient based on the current section of the level.
+    // The hardware blends it down the screen, so the colors only change
+    // (and are only written) when a new section starts
+    int section = level_position / (LEVEL_LENGTH / LEVEL_SECTIONS * BLOCK_SIZE);
+    if (section >= LEVEL_SECTIONS) {
+        section = LEVEL_SECTIONS - 1; // Past the end, or endless: keep the last colors
+    }
+    int level_progress = section * 100 / (LEVEL_SECTIONS - 1);
     
     arg.bg_r = 50 + (level_progress * 150) / 100;
     arg.bg_g = 100 + (level_progress * 50) / 100;
     arg.bg_b = 200 - (level_progress * 100) / 100;
     
-    // Keep values in range
-    if (arg.bg_r > 255) arg.bg_r = 255;
-    if (arg.bg_g > 255) arg.bg_g = 255;
-    if (arg.bg_b > 255) arg.bg_b = 255;
-    
-    ioctl(fd, WRITE_BACKGROUND_R, &arg);
-    ioctl(fd, WRITE_BACKGROUND_G, &arg);
-    ioctl(fd, WRITE_BACKGROUND_B, &arg);
+    // Darker toward the ground
+    arg.bg_bottom_r = arg.bg_r / 2;
+    arg.bg_bottom_g = arg.bg_g / 2;
+    arg.bg_bottom_b = arg.bg_b / 2;
     
     // Set flags based on game state
     arg.flags = 0;
@@ -355,23 +662,199 @@ void updateDisplay() {
     if (player.is_dead) arg.flags |= PLAYER_DEAD;
     if (player.is_gravity_inverted) arg.flags |= PLAYER_INVERTED;
     
-    ioctl(fd, WRITE_FLAGS, &arg);
-    
     // Output flags can be used to indicate game state to the hardware
     arg.output_flags = score / 1000; // Just an example
-    ioctl(fd, WRITE_OUTPUT_FLAGS, &arg);
+    arg.audio = 0;
+    
+    commitFrame(&arg);
+}
+
+void commitFrame(const geo_dash_arg_t *regs) {
+    // Send every changed register to the backend in one call
+    geo_dash_frame_t frame;
+    
+    frame.regs = *regs;
+    frame.dirty = 0;
+    if (!shadow_valid) {
+        frame.dirty = DIRTY_ALL;
+    } else {
+        if (regs->player_y != shadow.player_y) frame.dirty |= DIRTY_PLAYER_Y;
+        if (regs->x_shift != shadow.x_shift) frame.dirty |= DIRTY_X_SHIFT;
+        if (regs->bg_r != shadow.bg_r) frame.dirty |= DIRTY_BACKGROUND_R;
+        if (regs->bg_g != shadow.bg_g) frame.dirty |= DIRTY_BACKGROUND_G;
+        if (regs->bg_b != shadow.bg_b) frame.dirty |= DIRTY_BACKGROUND_B;
+        if (regs->map_block != shadow.map_block) frame.dirty |= DIRTY_MAP_BLOCK;
+        if (regs->flags != shadow.flags) frame.dirty |= DIRTY_FLAGS;
+        if (regs->output_flags != shadow.output_flags) frame.dirty |= DIRTY_OUTPUT_FLAGS;
+        if (regs->bg_bottom_r != shadow.bg_bottom_r) frame.dirty |= DIRTY_BACKGROUND_BOTTOM_R;
+        if (regs->bg_bottom_g != shadow.bg_bottom_g) frame.dirty |= DIRTY_BACKGROUND_BOTTOM_G;
+        if (regs->bg_bottom_b != shadow.bg_bottom_b) frame.dirty |= DIRTY_BACKGROUND_BOTTOM_B;
+    }
+    
+    // Nothing changed this frame: skip the backend entirely
+    if (frame.dirty == 0) {
+        return;
+    }
+    
+    if (device->commit_frame(device, &frame) == -1) {
+        return;
+    }
+    
+    shadow = *regs;
+    shadow_valid = 1;
 }
 
 void startAudioPlayback() {
-    // Start the background music
-    // In a real implementation, this would communicate with audio hardware
-    printf("Starting audio playback...\n");
+    // Start the background music from the top
+    if (audio_enabled) {
+        device->audio_stats(device, NULL);
+        mixer_post(&mixer, MIXER_PLAY, VOICE_MUSIC, MUSIC_GAIN);
+    }
+}
+
+void playSound(int voice) {
+    // Lock-free hand-off to the audio thread; heard within AUDIO_QUEUE_FRAMES
+    if (audio_enabled) {
+        mixer_post(&mixer, MIXER_PLAY, voice, EFFECT_GAIN);
+    }
+}
+
+int startAudio() {
+    // Attach the music and start feeding the device
+    if (!device->has_audio) {
+        return 0;
+    }
+    
+    mixer_init(&mixer);
+    if (audio_source_open(&music, MUSIC_FILE) == 0) {
+        mixer_set_voice(&mixer, VOICE_MUSIC, music.samples, music.frames, 1);
+    } else if (!headless) {
+        perror("Error opening " MUSIC_FILE);
+    }
+    audio_enabled = 1;
+    
+    // On virtual time the game loop pumps audio itself; a thread would spin
+    if (headless) {
+        return 1;
+    }
+    atomic_store(&audio_running, 1);
+    if (pthread_create(&audio_thread, NULL, audioThread, NULL) != 0) {
+        audio_source_close(&music);
+        audio_enabled = 0;
+        return 0;
+    }
+    audio_threaded = 1;
+    return 1;
+}
+
+void stopAudio() {
+    if (!audio_enabled) {
+        return;
+    }
+    if (audio_threaded) {
+        atomic_store(&audio_running, 0);
+        pthread_join(audio_thread, NULL);
+        audio_threaded = 0;
+    }
+    audio_source_close(&music);
+    audio_enabled = 0;
+}
+
+int pumpAudio() {
+    // Stay at most AUDIO_QUEUE_FRAMES ahead of the codec so a new sound
+    // effect is never stuck behind a long queue of music.  Returns the
+    // frames still to wait before the next block fits, or -1 on error
+    uint32_t words[MIXER_BLOCK_FRAMES];
+    long queued;
+    
+    for (;;) {
+        queued = device->audio_queued(device);
+        if (queued != -1 && queued + MIXER_BLOCK_FRAMES > AUDIO_QUEUE_FRAMES) {
+            return queued + MIXER_BLOCK_FRAMES - AUDIO_QUEUE_FRAMES;
+        }
+        mixer_render(&mixer, words);
+        if (device->push_audio(device, words, MIXER_BLOCK_FRAMES) == -1) {
+            return -1;
+        }
+        if (queued == -1) {
+            return 0; // Unknown depth: one block per call, writes block instead
+        }
+    }
+}
+
+void *audioThread(void *unused) {
+    int wait;
+    
+    while (atomic_load(&audio_running)) {
+        wait = pumpAudio();
+        if (wait == -1) {
+            break;
+        }
+        usleep(wait * 1000000LL / MIXER_RATE);
+    }
+    return NULL;
+}
+
+void generateLevel(uint64_t seed) {
+    // Sections the verifier finds no way through are redrawn
+    if (generate_level_verified(level_buf, LEVEL_LENGTH, seed) == -1) {
+        generate_level_seeded(level_buf, LEVEL_LENGTH, seed);
+    }
+}
+
+int levelComplete() {
+    // A level of fixed length is beaten by running off its end
+    return !endless && physics_column(&player) >= window.level_length;
 }
 
 void gameOver() {
     // Handle game over state
-    printf("Game Over! Final score: %d\n", score);
-    printf("Press button to restart\n");
+    if (audio_enabled) {
+        mixer_post(&mixer, MIXER_STOP, VOICE_MUSIC, 0);
+    }
+    games_played++;
+    total_score += score;
+    if (player.is_dead) {
+        playSound(VOICE_DEATH);
+        message("Game Over! Final score: %d\n", score);
+    } else {
+        message("Level complete! Final score: %d\n", score);
+    }
+    message("%lld physics steps over %lld frames, %lld frames skipped, slowest %lld ns\n",
+            loop_stats.total_steps, loop_stats.total_frames,
+            loop_stats.frames_skipped, loop_stats.max_sim_ns);
+    
+    // Audio glitches this run, to line up with the loop stalls above
+    audio_fifo_stats_t audio_stats;
+    if (audio_enabled && device->audio_stats(device, &audio_stats) == 0) {
+        message("Audio: %u underflows, %u overflows, lowest FIFO fill %u/%d\n",
+                audio_stats.underflows, audio_stats.overflows,
+                audio_stats.min_fill, AUDIO_FIFO_DEPTH);
+    }
+    
+    // Save the inputs of the game just finished, replacing the previous one
+    if (record_file) {
+        recording.final_hash = stateHash();
+        if (replay_save(&recording, record_file) == -1) {
+            perror("Error saving replay");
+        } else {
+            message("Recorded %u steps to %s\n", recording.ticks, record_file);
+        }
+    }
+    
+    // Level generation this run, to show it never held up a frame
+    if (endless) {
+        LevelStream *ls = &level_stream;
+        message("Level: %llu chunks, mean %lld ns, slowest %lld ns, %u late\n",
+                (unsigned long long)ls->chunks, ls->total_ns / (long long)ls->chunks,
+                ls->max_ns, ls->late);
+        stream_chunks += ls->chunks;
+        stream_ns += ls->total_ns;
+        if (ls->max_ns > stream_max_ns) {
+            stream_max_ns = ls->max_ns;
+        }
+    }
+    message("Press button to restart\n");
     
     // Save high score if needed
     // This would normally write to a file
@@ -0,0 +1,209 @@
+#include <stdint.h>
+#include <string.h>
+#include "audio_source.h"
+#include "mixer.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIXER_SIMD_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MIXER_SIMD_SSE2
+#endif
+
+// Sound effect lengths in frames
+#define JUMP_FRAMES (MIXER_RATE / 12)     // 83 ms
+#define PORTAL_FRAMES (MIXER_RATE / 4)    // 250 ms
+#define DEATH_FRAMES (MIXER_RATE * 2 / 5) // 400 ms
+
+#define EFFECT_AMPLITUDE 12000            // Peak level of the built-in effects
+
+// Built-in effects, synthesized once by mixer_init()
+static int16_t jump_sound[JUMP_FRAMES * 2];
+static int16_t portal_sound[PORTAL_FRAMES * 2];
+static int16_t death_sound[DEATH_FRAMES * 2];
+static int effects_ready = 0;
+
+// Phase step for a frequency, 2^32 per cycle
+static uint32_t phase_step(int hz) {
+    return (uint32_t)(((uint64_t)hz << 32) / MIXER_RATE);
+}
+
+// Linear fade from EFFECT_AMPLITUDE to 0 over a sound
+static int envelope(int frame, int frames) {
+    return EFFECT_AMPLITUDE - (int)((int64_t)EFFECT_AMPLITUDE * frame / frames);
+}
+
+// Upward square-wave chirp, 440 Hz to 880 Hz
+static void synth_jump(void) {
+    uint32_t phase = 0;
+    for (int i = 0; i < JUMP_FRAMES; i++) {
+        int level = envelope(i, JUMP_FRAMES);
+        int16_t s = (int16_t)((phase & 0x80000000u) ? -level : level);
+        jump_sound[2 * i] = jump_sound[2 * i + 1] = s;
+        phase += phase_step(440 + 440 * i / JUMP_FRAMES);
+    }
+}
+
+// Triangle wave warbling around 660 Hz
+static void synth_portal(void) {
+    uint32_t phase = 0;
+    for (int i = 0; i < PORTAL_FRAMES; i++) {
+        int level = envelope(i, PORTAL_FRAMES);
+        int tri = (int)(phase >> 16) - 32768;              // Sawtooth -32768..32767
+        tri = (tri < 0 ? -tri : tri) * 2 - 32768;          // Fold into a triangle
+        int16_t s = (int16_t)(tri * level / 32768);
+        portal_sound[2 * i] = portal_sound[2 * i + 1] = s;
+        int wobble = ((i / (MIXER_RATE / 16)) & 1) ? 110 : -110;
+        phase += phase_step(660 + wobble);
+    }
+}
+
+// Decaying noise burst, slightly different per channel
+static void synth_death(void) {
+    uint32_t noise = 0x12345678u;
+    for (int i = 0; i < DEATH_FRAMES; i++) {
+        int level = envelope(i, DEATH_FRAMES);
+        noise = noise * 1664525u + 1013904223u;
+        death_sound[2 * i] = (int16_t)((int16_t)(noise >> 16) * level / 32768);
+        death_sound[2 * i + 1] = (int16_t)((int16_t)noise * level / 32768);
+    }
+}
+
+static inline int16_t saturate16(int32_t x) {
+    return x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : (int16_t)x;
+}
+
+// Saturating add of a gain-scaled stereo buffer into an accumulator
+void mixer_accumulate(int16_t* acc, const int16_t* samples, size_t frames, int16_t gain) {
+    size_t n = frames * 2;
+    size_t i = 0;
+
+#if defined(MIXER_SIMD_NEON)
+    // Rounding Q15 multiply, then saturating add: 8 samples per iteration
+    int16x8_t g = vdupq_n_s16(gain);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t s = vqrdmulhq_s16(vld1q_s16(samples + i), g);
+        vst1q_s16(acc + i, vqaddq_s16(vld1q_s16(acc + i), s));
+    }
+#elif defined(MIXER_SIMD_SSE2)
+    // Same rounding as vqrdmulh, via a widened multiply
+    const __m128i g = _mm_set1_epi16(gain);
+    const __m128i round = _mm_set1_epi32(0x4000);
+    for (; i + 8 <= n; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(samples + i));
+        __m128i lo = _mm_mullo_epi16(s, g);
+        __m128i hi = _mm_mulhi_epi16(s, g);
+        __m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 15);
+        __m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 15);
+        __m128i a = _mm_loadu_si128((const __m128i*)(acc + i));
+        _mm_storeu_si128((__m128i*)(acc + i), _mm_adds_epi16(a, _mm_packs_epi32(p0, p1)));
+    }
+#endif
+
+    for (; i < n; i++) {
+        int16_t s = (int16_t)(((int32_t)samples[i] * gain + 0x4000) >> 15);
+        acc[i] = saturate16((int32_t)acc[i] + s);
+    }
+}
+
+// Reset all voices and the queue, and attach the built-in sound effects
+void mixer_init(Mixer* mixer) {
+    if (!effects_ready) {
+        synth_jump();
+        synth_portal();
+        synth_death();
+        effects_ready = 1;
+    }
+
+    memset(mixer->voices, 0, sizeof(mixer->voices));
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        mixer->voices[v].gain = GAIN_UNITY;
+    }
+    atomic_init(&mixer->head, 0);
+    atomic_init(&mixer->tail, 0);
+    mixer->gain = GAIN_UNITY;
+
+    mixer_set_voice(mixer, VOICE_JUMP, jump_sound, JUMP_FRAMES, 0);
+    mixer_set_voice(mixer, VOICE_PORTAL, portal_sound, PORTAL_FRAMES, 0);
+    mixer_set_voice(mixer, VOICE_DEATH, death_sound, DEATH_FRAMES, 0);
+}
+
+// Attach a sound to a voice; call before the audio thread starts
+void mixer_set_voice(Mixer* mixer, int voice, const int16_t* samples, size_t frames, int loop) {
+    MixerVoice* v = &mixer->voices[voice];
+    v->samples = samples;
+    v->frames = frames;
+    v->position = 0;
+    v->loop = loop;
+    v->active = 0;
+}
+
+// Queue a command from the game thread; never blocks or allocates
+int mixer_post(Mixer* mixer, int command, int voice, int16_t gain) {
+    unsigned tail = atomic_load_explicit(&mixer->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&mixer->head, memory_order_acquire);
+
+    if (tail - head == MIXER_QUEUE_SIZE) {
+        return -1;
+    }
+    MixerCommand* c = &mixer->queue[tail & MIXER_QUEUE_MASK];
+    c->command = command;
+    c->voice = voice;
+    c->gain = gain;
+    atomic_store_explicit(&mixer->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+// Apply every command posted since the last block
+static void apply_commands(Mixer* mixer) {
+    unsigned head = atomic_load_explicit(&mixer->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&mixer->tail, memory_order_acquire);
+
+    for (; head != tail; head++) {
+        const MixerCommand* c = &mixer->queue[head & MIXER_QUEUE_MASK];
+        if (c->voice >= MIXER_VOICES) {
+            continue;
+        }
+        MixerVoice* v = &mixer->voices[c->voice];
+        switch (c->command) {
+            case MIXER_PLAY:
+                v->position = 0;
+                v->gain = c->gain;
+                v->active = v->samples != NULL && v->frames > 0;
+                break;
+            case MIXER_STOP:
+                v->active = 0;
+                break;
+        }
+    }
+    atomic_store_explicit(&mixer->head, head, memory_order_release);
+}
+
+// Apply pending commands and mix one block into FIFO words (audio thread)
+void mixer_render(Mixer* mixer, uint32_t* words) {
+    apply_commands(mixer);
+    memset(mixer->mix, 0, sizeof(mixer->mix));
+
+    for (int i = 0; i < MIXER_VOICES; i++) {
+        MixerVoice* v = &mixer->voices[i];
+        size_t done = 0;
+
+        // A looping voice may wrap several times within one block
+        while (v->active && done < MIXER_BLOCK_FRAMES) {
+            size_t n = v->frames - v->position;
+            if (n > MIXER_BLOCK_FRAMES - done) {
+                n = MIXER_BLOCK_FRAMES - done;
+            }
+            mixer_accumulate(mixer->mix + 2 * done, v->samples + 2 * v->position, n, v->gain);
+            done += n;
+            v->position += n;
+            if (v->position == v->frames) {
+                v->position = 0;
+                v->active = v->loop;
+            }
+        }
+    }
+
+    audio_pack_mono(words, mixer->mix, MIXER_BLOCK_FRAMES, mixer->gain);
+}
@@ -0,0 +1,67 @@
+#ifndef _MIXER_H
+#define _MIXER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define MIXER_RATE 48000          // Output sample rate (Hz)
+#define MIXER_BLOCK_FRAMES 256    // Frames rendered per block (5.3 ms)
+#define MIXER_QUEUE_SIZE 16       // Pending commands (power of two)
+#define MIXER_QUEUE_MASK (MIXER_QUEUE_SIZE - 1)
+
+// Voices
+#define VOICE_MUSIC 0
+#define VOICE_JUMP 1
+#define VOICE_DEATH 2
+#define VOICE_PORTAL 3
+#define MIXER_VOICES 4
+
+// Commands from the game thread
+#define MIXER_PLAY 1              // Restart a voice from its first frame
+#define MIXER_STOP 2              // Silence a voice
+
+// One sound: interleaved stereo int16, owned by the caller
+typedef struct {
+    const int16_t* samples;       // Interleaved L/R samples
+    size_t frames;                // Stereo frames in the sound
+    size_t position;              // Next frame to mix
+    int16_t gain;                 // Q15 gain, 0..GAIN_UNITY
+    int loop;                     // Whether the sound restarts at its end
+    int active;                   // Whether the voice is playing
+} MixerVoice;
+
+typedef struct {
+    uint8_t command;              // MIXER_PLAY or MIXER_STOP
+    uint8_t voice;                // Voice the command applies to
+    int16_t gain;                 // New gain for MIXER_PLAY
+} MixerCommand;
+
+// Voices plus a single-producer single-consumer command queue: the game
+// thread posts commands, the audio thread applies them before each block
+typedef struct {
+    MixerVoice voices[MIXER_VOICES];
+    MixerCommand queue[MIXER_QUEUE_SIZE];
+    atomic_uint head;             // Next command to apply (audio thread)
+    atomic_uint tail;             // Next free slot (game thread)
+    int16_t gain;                 // Master Q15 gain
+    int16_t mix[MIXER_BLOCK_FRAMES * 2]; // Accumulator for one block
+} Mixer;
+
+// Reset all voices and the queue, and attach the built-in sound effects
+void mixer_init(Mixer* mixer);
+
+// Attach a sound to a voice; call before the audio thread starts
+void mixer_set_voice(Mixer* mixer, int voice, const int16_t* samples, size_t frames, int loop);
+
+// Queue a command from the game thread; never blocks or allocates.
+// Returns 0, or -1 if the queue is full and the command was dropped
+int mixer_post(Mixer* mixer, int command, int voice, int16_t gain);
+
+// Apply pending commands and mix one block into FIFO words (audio thread)
+void mixer_render(Mixer* mixer, uint32_t* words);
+
+// Saturating add of a gain-scaled stereo buffer into an accumulator
+void mixer_accumulate(int16_t* acc, const int16_t* samples, size_t frames, int16_t gain);
+
+#endif // _MIXER_H
@@ -0,0 +1,15 @@
+// Generated by hw/gen_tiles.py from the art in hw/images; do not edit.
+// Each obstacle's opaque pixels in its 32x32 cell: x, y, w, h
+#ifndef _OBSTACLE_BOXES_H
+#define _OBSTACLE_BOXES_H
+
+#define OBS_SPIKE_BOX          0, 2, 32, 30  // regular_spike.png
+#define OBS_BLOCK_BOX          0, 0, 32, 32  // square.png
+#define OBS_PLATFORM_BOX       0, 0, 32, 32  // platform.png
+#define OBS_JUMP_PAD_BOX       0, 24, 32, 8  // jump pad strip
+#define OBS_GRAVITY_PORTAL_BOX 2, 0, 30, 32  // portal.png
+#define OBS_SHORT_SPIKE_BOX    0, 2, 32, 30  // short_spike.png
+#define OBS_RAZOR_BOX          2, 0, 28, 30  // razor.png
+#define OBS_SLOPE_BOX          2, 2, 30, 30  // slope.png
+
+#endif // _OBSTACLE_BOXES_H
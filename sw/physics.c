@@ -0,0 +1,508 @@
+#include <limits.h>
+#include "geo_dash.h"
+#include "physics.h"
+#include "obstacle_boxes.h"
+
+// What touching an obstacle's hitbox does
+#define EFFECT_SPIKE 1        // Dies
+#define EFFECT_BLOCK 2        // Dies
+#define EFFECT_RAZOR 3        // Dies
+#define EFFECT_LAND 4         // Lands on its top when falling onto it
+#define EFFECT_JUMP_PAD 5     // Launches on entering it
+#define EFFECT_PORTAL 6       // Flips gravity on entering it
+
+// An obstacle's hitbox within its 32x32 cell, in sprite pixels
+typedef struct {
+    uint8_t x, y, w, h;
+    uint8_t effect;
+} Hitbox;
+
+// Hitboxes are the opaque bounds of the art in hw/images, the same pixels
+// the tileset draws, so what touches on screen touches in the physics
+static const Hitbox hitboxes[GRID_TYPES] = {
+    [OBS_SPIKE] = { OBS_SPIKE_BOX, EFFECT_SPIKE },
+    [OBS_BLOCK] = { OBS_BLOCK_BOX, EFFECT_BLOCK },
+    [OBS_PLATFORM] = { OBS_PLATFORM_BOX, EFFECT_LAND },
+    [OBS_JUMP_PAD] = { OBS_JUMP_PAD_BOX, EFFECT_JUMP_PAD },
+    [OBS_GRAVITY_PORTAL] = { OBS_GRAVITY_PORTAL_BOX, EFFECT_PORTAL },
+    [OBS_SHORT_SPIKE] = { OBS_SHORT_SPIKE_BOX, EFFECT_SPIKE },
+    [OBS_RAZOR] = { OBS_RAZOR_BOX, EFFECT_RAZOR },
+    [OBS_SLOPE] = { OBS_SLOPE_BOX, EFFECT_LAND },
+};
+
+// n / d rounded to nearest, for d > 0
+static int32_t round_div(int64_t n, int64_t d) {
+    return n >= 0 ? (n + d / 2) / d : -((-n + d / 2) / d);
+}
+
+// Build the arc table for a tick rate.  Each entry is rounded on its own,
+// so the arcs carry no error that grows along them
+void physics_rate_init(PhysicsRate* rate, int hz) {
+    int64_t hz2 = (int64_t)hz * hz;
+
+    rate->hz = hz;
+    rate->speed = round_div((int64_t)RUN_SPEED * FIX_ONE, hz);
+    rate->rest = round_div((int64_t)TERMINAL_SPEED * hz, GRAVITY);
+    rate->jump = rate->rest - round_div((int64_t)JUMP_SPEED * hz, GRAVITY);
+    rate->jump_pad = rate->rest - round_div((int64_t)JUMP_PAD_SPEED * hz, GRAVITY);
+    rate->last = 2 * rate->rest;
+    for (int i = 0; i <= rate->last; i++) {
+        rate->arc[i] = round_div((int64_t)(i - rate->rest) * GRAVITY * FIX_ONE, hz2);
+    }
+}
+
+// Put the player on the ground at the start of the level
+void physics_reset(Player* player, const PhysicsRate* rate) {
+    player->rate = rate;
+    player->x_pos = 0;
+    player->y_pos = GROUND_Y * FIX_ONE;
+    player->arc = rate->rest;
+    player->from_x = player->x_pos;
+    player->from_y = player->y_pos;
+    player->is_jumping = 0;
+    player->is_dead = 0;
+    player->is_gravity_inverted = 0;
+    player->gravity_direction = 1;
+}
+
+// Jump, fall and move one step forward; returns PHYS_* events
+int physics_move(Player* player, int pressed) {
+    const PhysicsRate* rate = player->rate;
+    int events = 0;
+
+    player->from_x = player->x_pos;
+    player->from_y = player->y_pos;
+
+    // Jump when button is pressed and player is on ground
+    if (pressed && !player->is_jumping) {
+        player->arc = rate->jump;
+        player->is_jumping = 1;
+        events |= PHYS_JUMPED;
+    }
+
+    // Apply gravity: one step further along the arc, up to terminal speed
+    if (player->arc < rate->last) {
+        player->arc++;
+    }
+
+    // Update player position
+    player->y_pos += player->gravity_direction * rate->arc[player->arc];
+
+    // Check if player has landed on ground (depends on gravity direction)
+    if (player->gravity_direction > 0) {
+        // Normal gravity
+        if (player->y_pos >= GROUND_Y * FIX_ONE) {
+            player->y_pos = GROUND_Y * FIX_ONE;
+            player->arc = rate->rest;
+            player->is_jumping = 0;
+        }
+    } else {
+        // Inverted gravity
+        if (player->y_pos <= CEILING_Y * FIX_ONE) { // Top of the screen
+            player->y_pos = CEILING_Y * FIX_ONE;
+            player->arc = rate->rest;
+            player->is_jumping = 0;
+        }
+    }
+
+    // Move forward (the level scrolls, the player stays in place on screen)
+    player->x_pos += rate->speed;
+    return events;
+}
+
+// Whether the player's hitbox, its top-left swept from (x0, y0) to
+// (x1, y1), overlaps a w x h box at any point along the way.  Coordinates
+// are Q8 relative to the box's top-left; touching edges do not overlap.
+// This is a separating axis test of the sweep against the box grown by
+// the hitbox: the bounding box of the sweep, then the sweep's normal
+static int swept_overlap(int64_t x0, int64_t y0, int64_t x1, int64_t y1, int w, int h) {
+    int64_t left = -PLAYER_BOX_W * FIX_ONE, right = w * FIX_ONE;
+    int64_t top = -PLAYER_BOX_H * FIX_ONE, bottom = h * FIX_ONE;
+    int64_t dx = x1 - x0, dy = y1 - y0;
+
+    if ((x0 > x1 ? x0 : x1) <= left || (x0 < x1 ? x0 : x1) >= right ||
+        (y0 > y1 ? y0 : y1) <= top || (y0 < y1 ? y0 : y1) >= bottom) {
+        return 0;
+    }
+
+    // Project onto (-dy, dx): the sweep is one point, the box an interval
+    int64_t c = dx * y0 - dy * x0;
+    int64_t lo = (dx < 0 ? dx * bottom : dx * top) + (dy < 0 ? -dy * left : -dy * right);
+    int64_t hi = (dx < 0 ? dx * top : dx * bottom) + (dy < 0 ? -dy * right : -dy * left);
+    return (dx == 0 && dy == 0) || (lo < c && c < hi);
+}
+
+// Lower the landing to the top of a surface the hitbox's bottom crossed in
+// the last move, if it is higher.  Only for a player falling down the screen
+static void land_on(const Player* player, int type, int column, int row, int* landing) {
+    const Hitbox* box = &hitboxes[type];
+    int64_t x0 = player->from_x + (int64_t)(PLAYER_X + PLAYER_BOX_X) * FIX_ONE;
+    int64_t x1 = player->x_pos + (int64_t)(PLAYER_X + PLAYER_BOX_X) * FIX_ONE;
+    int64_t left = ((int64_t)column * BLOCK_SIZE + box->x) * FIX_ONE;
+    int top = (GROUND_Y - row * BLOCK_SIZE + box->y) * FIX_ONE;
+
+    if (box->effect == EFFECT_LAND && top < *landing &&
+        player->from_y + PLAYER_BOX_H * FIX_ONE <= top &&
+        player->y_pos + PLAYER_BOX_H * FIX_ONE > top &&
+        (x0 > x1 ? x0 : x1) > left - PLAYER_BOX_W * FIX_ONE &&
+        (x0 < x1 ? x0 : x1) < left + box->w * FIX_ONE) {
+        *landing = top;
+    }
+}
+
+// Apply one obstacle if the last move's sweep passed through it; returns
+// PHYS_* events
+static int touch(Player* player, int type, int column, int row) {
+    const PhysicsRate* rate = player->rate;
+    const Hitbox* box = &hitboxes[type];
+    int64_t x0 = player->from_x + (int64_t)(PLAYER_X + PLAYER_BOX_X) * FIX_ONE;
+    int64_t x1 = player->x_pos + (int64_t)(PLAYER_X + PLAYER_BOX_X) * FIX_ONE;
+    int64_t y0 = player->from_y;
+    int64_t left = ((int64_t)column * BLOCK_SIZE + box->x) * FIX_ONE;
+    int64_t top = (GROUND_Y - row * BLOCK_SIZE + box->y) * FIX_ONE;
+
+    if (!swept_overlap(x0 - left, y0 - top, x1 - left, player->y_pos - top, box->w, box->h)) {
+        return 0;
+    }
+    switch (box->effect) {
+        case EFFECT_SPIKE:
+            return PHYS_HIT_SPIKE;
+
+        case EFFECT_BLOCK:
+            return PHYS_HIT_BLOCK;
+
+        case EFFECT_RAZOR:
+            return PHYS_HIT_RAZOR;
+
+        case EFFECT_JUMP_PAD:
+        case EFFECT_PORTAL:
+            // Only on the step that enters it
+            if (swept_overlap(x0 - left, y0 - top, x0 - left, y0 - top, box->w, box->h)) {
+                return 0;
+            }
+            if (box->effect == EFFECT_JUMP_PAD) {
+                // Extra boost jump
+                player->arc = rate->jump_pad;
+                player->is_jumping = 1;
+                return PHYS_JUMPED;
+            }
+            // Invert gravity, keeping the velocity on screen
+            player->arc = rate->last - player->arc;
+            player->gravity_direction *= -1;
+            player->is_gravity_inverted = !player->is_gravity_inverted;
+            return PHYS_PORTAL;
+    }
+    return 0;
+}
+
+// Kill the player on a hazard or off the screen; returns the events given
+// plus PHYS_OFF_SCREEN if it left
+static int settle(Player* player, int events) {
+    int y = player->y_pos >> FIX_SHIFT;
+
+    if (events & (PHYS_HIT_SPIKE | PHYS_HIT_BLOCK | PHYS_HIT_RAZOR)) {
+        player->is_dead = 1;
+    }
+
+    // Check if player went off screen
+    if ((player->gravity_direction > 0 && y < 0) ||
+        (player->gravity_direction < 0 && y > OFF_SCREEN_Y)) {
+        player->is_dead = 1;
+        events |= PHYS_OFF_SCREEN;
+    }
+    return events;
+}
+
+// Apply the obstacles the player's hitbox swept over; returns PHYS_* events
+int physics_collide(Player* player, int first, const GridColumn* columns, int count) {
+    const PhysicsRate* rate = player->rate;
+    int events = 0;
+    int landing = INT_MAX;
+
+    // Land on the highest surface the hitbox's bottom crossed while falling
+    if (player->gravity_direction > 0 && player->y_pos > player->from_y) {
+        for (int i = 0; i < count; i++) {
+            for (GridColumn bits = columns[i]; bits; bits &= bits - 1) {
+                int bit = __builtin_ctzll(bits);
+                land_on(player, bit / GRID_LANE_BITS, first + i, bit % GRID_LANE_BITS, &landing);
+            }
+        }
+        if (landing != INT_MAX) {
+            player->y_pos = landing - PLAYER_BOX_H * FIX_ONE;
+            player->arc = rate->rest;
+            player->is_jumping = 0;
+        }
+    }
+
+    // Everything else the sweep, up to any landing, passed through
+    for (int i = 0; i < count; i++) {
+        for (GridColumn bits = columns[i]; bits; bits &= bits - 1) {
+            int bit = __builtin_ctzll(bits);
+            events |= touch(player, bit / GRID_LANE_BITS, first + i, bit % GRID_LANE_BITS);
+        }
+    }
+    return settle(player, events);
+}
+
+#if defined(BENCH_PHYSICS) || defined(BENCH_LEVEL_GRID)
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 50               // Timed rounds; the best one counts
+
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#endif
+
+#ifdef BENCH_PHYSICS
+#include "level_generator.h"
+#include "level_window.h"
+
+#define BENCH_PASSES 20               // Ghost runs through the level per round
+
+// Run a ghost that cannot die through the level, pressing now and then;
+// returns its events, folded together so both modes can be compared
+static uint32_t ghost_runs(const uint8_t* level, const PhysicsRate* rate, int broadphase,
+                           long long* ticks, long long* skipped) {
+    static LevelWindow window;
+    GridColumn cells[PHYSICS_MAX_COLUMNS];
+    uint32_t fold = 0;
+
+    *ticks = *skipped = 0;
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        Player player;
+
+        physics_reset(&player, rate);
+        window_init(&window, level, MAX_LEVEL_LENGTH);
+        while (physics_last_column(&player) < MAX_LEVEL_LENGTH) {
+            int count = 0;
+
+            physics_move(&player, (*ticks + pass) % 23 == 0);
+            int first = physics_first_column(&player);
+            int last = physics_last_column(&player);
+            while (window.head < first) {
+                window_advance(&window);
+            }
+            if (!broadphase || window_next_obstacle(&window, first) <= last) {
+                for (int column = first; column <= last; column++) {
+                    cells[count++] = window_cell(&window, column);
+                }
+            } else {
+                (*skipped)++;
+            }
+            fold = fold * 31 + physics_collide(&player, first, cells, count);
+            player.is_dead = 0;
+            (*ticks)++;
+        }
+        fold = fold * 31 + player.y_pos;
+    }
+    return fold;
+}
+
+// Time the ghost with and without the broadphase, alternating the two so
+// drift and other load hit both alike; returns nonzero if they disagree
+static int bench_level(const char* name, const uint8_t* level, const PhysicsRate* rate) {
+    double best[2] = {1e9, 1e9};
+    uint32_t fold[2];
+    long long ticks, skipped;
+    int filled = 0;
+
+    for (int column = 0; column < MAX_LEVEL_LENGTH; column++) {
+        filled += level[column] != OBS_NONE;
+    }
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int broadphase = 0; broadphase <= 1; broadphase++) {
+            double t0 = seconds_now();
+            fold[broadphase] = ghost_runs(level, rate, broadphase, &ticks, &skipped);
+            double seconds = seconds_now() - t0;
+            if (seconds < best[broadphase]) {
+                best[broadphase] = seconds;
+            }
+        }
+        if (fold[0] != fold[1]) {
+            printf("%s: results DIFFER\n", name);
+            return 1;
+        }
+    }
+    printf("%s: %d%% of columns hold obstacles, the broadphase skips %.0f%% of ticks\n",
+           name, filled * 100 / MAX_LEVEL_LENGTH, skipped * 100.0 / ticks);
+    printf("  Every column:  %.1f ns per tick\n", best[0] / ticks * 1e9);
+    printf("  Broadphase:    %.1f ns per tick (best of %d, %lld ticks)\n",
+           best[1] / ticks * 1e9, BENCH_ROUNDS, ticks);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    static uint8_t level[MAX_LEVEL_LENGTH];
+    static PhysicsRate rate;
+    uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 0) : 1;
+    Player player;
+
+    // Falling at terminal speed at the slowest rate, the hitbox jumps
+    // 128 pixels a step, clean over a razor three rows up
+    GridColumn razor[2] = { 0, GRID_CELL(OBS_RAZOR, 3) };
+    physics_rate_init(&rate, PHYSICS_MIN_HZ);
+    physics_reset(&player, &rate);
+    player.y_pos = 40 * FIX_ONE;
+    player.arc = rate.last;
+    physics_move(&player, 0);
+    int events = physics_collide(&player, physics_first_column(&player), razor, 2);
+    printf("Razor at terminal speed: %s (y %d to %d)\n",
+           events & PHYS_HIT_RAZOR ? "hit" : "MISSED",
+           player.from_y >> FIX_SHIFT, player.y_pos >> FIX_SHIFT);
+    if (!(events & PHYS_HIT_RAZOR)) {
+        return 1;
+    }
+
+    physics_rate_init(&rate, PHYSICS_HZ);
+    generate_level_seeded(level, MAX_LEVEL_LENGTH, seed);
+    if (bench_level("Generated", level, &rate)) {
+        return 1;
+    }
+
+    // Every obstacle code in turn, one column in three: most ticks still
+    // sweep an obstacle, so this is near the broadphase's worst case
+    for (int column = 0; column < MAX_LEVEL_LENGTH; column++) {
+        level[column] = column % 3 ? OBS_NONE : 1 + column / 3 % (GRID_TYPES - 1);
+    }
+    return bench_level("Dense", level, &rate);
+}
+#endif
+
+#ifdef BENCH_LEVEL_GRID
+#include <string.h>
+
+#define BENCH_STATES 4096
+#define BENCH_PASSES 64
+
+// physics_collide() dispatching on each column's obstacle code with a
+// switch, as collisions did before the grid, instead of on its set bits
+static int collide_switch(Player* player, int first, const uint8_t* codes, int count) {
+    const PhysicsRate* rate = player->rate;
+    int events = 0;
+    int landing = INT_MAX;
+
+    if (player->gravity_direction > 0 && player->y_pos > player->from_y) {
+        for (int i = 0; i < count; i++) {
+            switch (codes[i]) {
+                case OBS_PLATFORM:
+                case OBS_SLOPE:
+                    land_on(player, codes[i], first + i, 0, &landing);
+                    break;
+
+                case OBS_BLOCK_PLATFORM:
+                    land_on(player, OBS_PLATFORM, first + i, 1, &landing);
+                    break;
+            }
+        }
+        if (landing != INT_MAX) {
+            player->y_pos = landing - PLAYER_BOX_H * FIX_ONE;
+            player->arc = rate->rest;
+            player->is_jumping = 0;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        switch (codes[i]) {
+            case OBS_SPIKE:
+            case OBS_BLOCK:
+            case OBS_PLATFORM:
+            case OBS_JUMP_PAD:
+            case OBS_GRAVITY_PORTAL:
+            case OBS_SHORT_SPIKE:
+            case OBS_RAZOR:
+            case OBS_SLOPE:
+                events |= touch(player, codes[i], first + i, 0);
+                break;
+
+            case OBS_BLOCK_PLATFORM:
+                events |= touch(player, OBS_BLOCK, first + i, 0);
+                events |= touch(player, OBS_PLATFORM, first + i, 1);
+                break;
+        }
+    }
+    return settle(player, events);
+}
+
+static int same_player(const Player* a, const Player* b) {
+    return a->y_pos == b->y_pos && a->arc == b->arc && a->is_jumping == b->is_jumping &&
+           a->is_dead == b->is_dead && a->is_gravity_inverted == b->is_gravity_inverted &&
+           a->gravity_direction == b->gravity_direction;
+}
+
+int main(int argc, char* argv[]) {
+    static Player states[BENCH_STATES];
+    static uint8_t codes[BENCH_STATES][PHYSICS_MAX_COLUMNS];
+    static GridColumn columns[BENCH_STATES][PHYSICS_MAX_COLUMNS];
+    static PhysicsRate rate;
+    double best[2] = {1e9, 1e9};
+    int events = 0;
+
+    // Random sweeps over the whole screen, against every obstacle code
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    physics_rate_init(&rate, PHYSICS_HZ);
+    for (int i = 0; i < BENCH_STATES; i++) {
+        int inverted = rand() & 1;
+        int64_t x = (int64_t)(rand() % (MAX_LEVEL_LENGTH * BLOCK_SIZE)) * FIX_ONE;
+        int y = rand() % ((OFF_SCREEN_Y + 40) * FIX_ONE) - 20 * FIX_ONE;
+        states[i] = (Player){
+            .rate = &rate,
+            .x_pos = x,
+            .y_pos = y,
+            .arc = rand() % (rate.last + 1),
+            .is_jumping = rand() & 1,
+            .is_gravity_inverted = inverted,
+            .gravity_direction = inverted ? -1 : 1,
+            .from_x = x - rate.speed,
+            .from_y = y - rate.arc[rand() % (rate.last + 1)] * (inverted ? -1 : 1),
+        };
+        for (int column = 0; column < PHYSICS_MAX_COLUMNS; column++) {
+            codes[i][column] = rand() % GRID_TYPES;
+            columns[i][column] = grid_column(codes[i][column]);
+        }
+    }
+
+    // The grid must do exactly what the switch does for every code
+    for (int i = 0; i < BENCH_STATES; i++) {
+        Player a = states[i], b = states[i];
+        int first = physics_first_column(&a);
+        int count = physics_last_column(&a) - first + 1;
+        int ea = collide_switch(&a, first, codes[i], count);
+        int eb = physics_collide(&b, first, columns[i], count);
+        if (ea != eb || !same_player(&a, &b)) {
+            fprintf(stderr, "Grid and switch disagree: codes %d %d, y %d, arc %d\n",
+                    codes[i][0], codes[i][1], states[i].y_pos, states[i].arc);
+            return 1;
+        }
+    }
+
+    // Alternate the two so drift and other load hit both alike
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int grid = 0; grid <= 1; grid++) {
+            double t0 = seconds_now();
+            for (int pass = 0; pass < BENCH_PASSES; pass++) {
+                for (int i = 0; i < BENCH_STATES; i++) {
+                    Player p = states[i];
+                    int first = physics_first_column(&p);
+                    int count = physics_last_column(&p) - first + 1;
+                    events += grid ? physics_collide(&p, first, columns[i], count)
+                                   : collide_switch(&p, first, codes[i], count);
+                }
+            }
+            double seconds = seconds_now() - t0;
+            if (seconds < best[grid]) {
+                best[grid] = seconds;
+            }
+        }
+    }
+
+    double queries = (double)BENCH_STATES * BENCH_PASSES;
+    printf("switch: %.1f Mqueries/s\n", queries / best[0] / 1e6);
+    printf("grid:   %.1f Mqueries/s (best of %d)\n", queries / best[1] / 1e6, BENCH_ROUNDS);
+    return events == 0; // Keep the loops from being optimized away
+}
+#endif
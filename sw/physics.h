@@ -0,0 +1,109 @@
+#ifndef _PHYSICS_H
+#define _PHYSICS_H
+
+#include <stdint.h>
+#include "level_grid.h"
+
+// Positions and velocities are Q8 fixed point: 256 units to the pixel
+#define FIX_SHIFT 8
+#define FIX_ONE (1 << FIX_SHIFT)
+
+// Game constants (pixels, and speeds in pixels per second so the tick
+// rate only changes how finely the arcs are sampled)
+#define GROUND_Y 220          // Ground position (higher number = lower on screen)
+#define CEILING_Y 50          // Where inverted gravity lands the player
+#define OFF_SCREEN_Y 300      // Inverted gravity kills below this line
+#define RUN_SPEED 360         // Horizontal movement speed
+#define JUMP_SPEED 780        // Initial jump speed (a jump stays above a spike's
+                              // 30 px for 104 px of run: clear of one spike,
+                              // 32 px, plus the player's 20, and of two)
+#define JUMP_PAD_SPEED 900    // Initial speed off a jump pad
+#define GRAVITY 3600          // Gravity acceleration (pixels/s^2)
+#define TERMINAL_SPEED 1920   // Fastest the player can rise or fall
+#define BLOCK_SIZE 32         // Size of a block in pixels
+#define BLOCK_SHIFT 5         // log2(BLOCK_SIZE)
+#define PLAYER_X 80           // Fixed player X position on screen
+
+// The player's hitbox within its sprite (player.png): the art's width and
+// the sprite's full height, so it stands on surfaces as on the ground
+#define PLAYER_BOX_X 6
+#define PLAYER_BOX_W 20
+#define PLAYER_BOX_H 32
+
+// Tick rates the arc tables cover.  PHYSICS_HZ is the default, where every
+// step is a whole number of pixels (6 across, velocity changing by 1)
+#define PHYSICS_HZ 60
+#define PHYSICS_MIN_HZ 15     // Below this a step crosses most of a column
+#define PHYSICS_MAX_HZ 1000
+#define PHYSICS_MAX_ARC (2 * TERMINAL_SPEED * PHYSICS_MAX_HZ / GRAVITY + 2)
+
+// Most level columns the player's box can sweep over in one step
+#define PHYSICS_MAX_COLUMNS ((PLAYER_BOX_W + RUN_SPEED / PHYSICS_MIN_HZ) / BLOCK_SIZE + 2)
+
+// What a step did, so the caller can play sounds and print messages
+#define PHYS_JUMPED 0x01      // Jumped off the ground or a jump pad
+#define PHYS_PORTAL 0x02      // Passed through a gravity portal
+#define PHYS_HIT_SPIKE 0x04   // Died on a spike
+#define PHYS_HIT_BLOCK 0x08   // Died on a block
+#define PHYS_OFF_SCREEN 0x10  // Died leaving the screen
+#define PHYS_HIT_RAZOR 0x20   // Died on a razor
+
+// Motion at one tick rate.  Every jump, jump pad and fall follows one arc:
+// arc[i] is the Q8 velocity (pixels/step, positive along gravity) i steps
+// after the player left the fastest rise, so a step is a lookup and an add.
+// The table is symmetric about rest, where the player stands still.
+typedef struct {
+    int hz;                   // Steps per second
+    int speed;                // Horizontal Q8 pixels per step
+    int rest;                 // Arc step with no vertical velocity
+    int jump;                 // Arc step a jump starts at
+    int jump_pad;             // Arc step a jump pad starts at
+    int last;                 // Final arc step, falling at TERMINAL_SPEED
+    int32_t arc[PHYSICS_MAX_ARC];
+} PhysicsRate;
+
+typedef struct {
+    const PhysicsRate* rate;  // Tick rate the player moves at
+    int64_t x_pos;            // Position in the level (Q8 pixels; 64 bits so
+                              // an endless run never wraps)
+    int y_pos;                // Position on screen (Q8 pixels)
+    int arc;                  // Step along the rate's arc (its velocity)
+    int is_jumping;           // Whether player is jumping
+    int is_dead;              // Whether player is dead
+    int is_gravity_inverted;  // Whether gravity is inverted
+    int gravity_direction;    // 1 for normal, -1 for inverted
+    int64_t from_x;           // Position before the last physics_move(),
+    int from_y;               // which physics_collide() sweeps from
+} Player;
+
+// Build the arc table for a tick rate in [PHYSICS_MIN_HZ, PHYSICS_MAX_HZ]
+void physics_rate_init(PhysicsRate* rate, int hz);
+
+// Put the player on the ground at the start of the level
+void physics_reset(Player* player, const PhysicsRate* rate);
+
+// Jump, fall and move one step forward; returns PHYS_* events
+int physics_move(Player* player, int pressed);
+
+// Sweep the player's hitbox along its last move against the obstacles in
+// columns[i], level column first + i, and apply them; returns PHYS_* events.
+// Pass the columns from physics_first_column() to physics_last_column(), or
+// none (count 0) when a broadphase already knows they are all empty
+int physics_collide(Player* player, int first, const GridColumn* columns, int count);
+
+// Level column the player occupies
+static inline int physics_column(const Player* player) {
+    return (int)(((player->x_pos >> FIX_SHIFT) + PLAYER_X) / BLOCK_SIZE);
+}
+
+// First and last level columns the hitbox swept over in the last move
+static inline int physics_first_column(const Player* player) {
+    return (int)((player->from_x + (PLAYER_X + PLAYER_BOX_X) * FIX_ONE) >> (FIX_SHIFT + BLOCK_SHIFT));
+}
+
+static inline int physics_last_column(const Player* player) {
+    return (int)((player->x_pos + (PLAYER_X + PLAYER_BOX_X + PLAYER_BOX_W) * FIX_ONE - 1) >>
+                 (FIX_SHIFT + BLOCK_SHIFT));
+}
+
+#endif // _PHYSICS_H
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "replay.h"
+
+#define REPLAY_INITIAL_BYTES 1024     // 8192 ticks, over two minutes at 60 Hz
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+static void put64(uint8_t* p, uint64_t v) {
+    put32(p, v);
+    put32(p + 4, v >> 32);
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+static uint64_t get64(const uint8_t* p) {
+    return get32(p) | (uint64_t)get32(p + 4) << 32;
+}
+
+// Start a new recording, keeping any buffer already allocated
+void replay_init(Replay* replay, uint64_t seed, int physics_hz) {
+    replay->seed = seed;
+    replay->physics_hz = physics_hz;
+    replay->ticks = 0;
+    replay->final_hash = 0;
+    if (replay->buttons) {
+        memset(replay->buttons, 0, replay->capacity);
+    }
+}
+
+// Append one tick's button state; returns 0, or -1 if out of memory
+int replay_record(Replay* replay, int pressed) {
+    size_t byte = replay->ticks >> 3;
+
+    if (byte >= replay->capacity) {
+        size_t capacity = replay->capacity ? replay->capacity * 2 : REPLAY_INITIAL_BYTES;
+        uint8_t* buttons = realloc(replay->buttons, capacity);
+        if (!buttons) {
+            return -1;
+        }
+        memset(buttons + replay->capacity, 0, capacity - replay->capacity);
+        replay->buttons = buttons;
+        replay->capacity = capacity;
+    }
+    if (pressed) {
+        replay->buttons[byte] |= 1 << (replay->ticks & 7);
+    }
+    replay->ticks++;
+    return 0;
+}
+
+int replay_save(const Replay* replay, const char* filename) {
+    uint8_t header[REPLAY_HEADER_BYTES];
+    size_t bytes = (replay->ticks + 7) / 8;
+    FILE* file = fopen(filename, "wb");
+
+    if (!file) {
+        return -1;
+    }
+    put32(header, REPLAY_MAGIC);
+    put16(header + 4, REPLAY_VERSION);
+    put16(header + 6, replay->physics_hz);
+    put64(header + 8, replay->seed);
+    put32(header + 16, replay->ticks);
+    put32(header + 20, replay->final_hash);
+
+    if (fwrite(header, sizeof(header), 1, file) != 1 ||
+        (bytes && fwrite(replay->buttons, bytes, 1, file) != 1)) {
+        fclose(file);
+        return -1;
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+int replay_load(Replay* replay, const char* filename) {
+    uint8_t header[REPLAY_HEADER_BYTES];
+    FILE* file = fopen(filename, "rb");
+    size_t bytes;
+
+    if (!file) {
+        return -1;
+    }
+    if (fread(header, sizeof(header), 1, file) != 1 ||
+        get32(header) != REPLAY_MAGIC || get16(header + 4) != REPLAY_VERSION) {
+        fclose(file);
+        errno = EINVAL;
+        return -1;
+    }
+
+    replay->physics_hz = get16(header + 6);
+    replay->seed = get64(header + 8);
+    replay->ticks = get32(header + 16);
+    replay->final_hash = get32(header + 20);
+
+    bytes = (replay->ticks + 7) / 8;
+    replay->buttons = malloc(bytes ? bytes : 1);
+    replay->capacity = bytes;
+    if (!replay->buttons) {
+        fclose(file);
+        return -1;
+    }
+    if (bytes && fread(replay->buttons, bytes, 1, file) != 1) {
+        replay_free(replay);
+        fclose(file);
+        errno = EINVAL;
+        return -1;
+    }
+    fclose(file);
+    return 0;
+}
+
+void replay_free(Replay* replay) {
+    free(replay->buttons);
+    replay->buttons = NULL;
+    replay->capacity = 0;
+}
+
+// Fold 32-bit words into an FNV-1a hash, byte by byte, little-endian
+uint32_t replay_hash(uint32_t hash, const int32_t* words, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t w = (uint32_t)words[i];
+        for (int b = 0; b < 4; b++) {
+            hash = (hash ^ ((w >> (8 * b)) & 0xFF)) * FNV_PRIME;
+        }
+    }
+    return hash;
+}
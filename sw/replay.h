@@ -0,0 +1,49 @@
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REPLAY_MAGIC 0x50524447u      // "GDRP" as a little-endian word
+#define REPLAY_VERSION 7              // 2: 64-bit level seed, 3: Q8 physics state,
+                                      // 4: verified levels, 5: 64-bit x position,
+                                      // 6: hitboxes from the art, 7: faster run
+                                      // and higher jump
+#define REPLAY_HEADER_BYTES 24        // magic, version, hz, seed, ticks, hash
+
+#define FNV_OFFSET 2166136261u        // FNV-1a 32-bit parameters
+#define FNV_PRIME 16777619u
+
+// One recorded game: the level seed plus the button state at every
+// physics tick, one bit per tick.  On disk the header fields are
+// little-endian and the bits follow, least significant bit first.
+typedef struct {
+    uint64_t seed;                    // Seed the level was generated from
+    uint16_t physics_hz;              // Tick rate the game ran at
+    uint32_t ticks;                   // Physics ticks recorded
+    uint32_t final_hash;              // State hash after the last tick
+    uint8_t* buttons;                 // Button bits, tick i in byte i / 8
+    size_t capacity;                  // Bytes allocated for buttons
+} Replay;
+
+// Start a new recording, keeping any buffer already allocated
+void replay_init(Replay* replay, uint64_t seed, int physics_hz);
+
+// Append one tick's button state; returns 0, or -1 if out of memory
+int replay_record(Replay* replay, int pressed);
+
+// Button state at a tick
+static inline int replay_button(const Replay* replay, uint32_t tick) {
+    return (replay->buttons[tick >> 3] >> (tick & 7)) & 1;
+}
+
+// Write or read a replay file; return 0, or -1 with errno set
+int replay_save(const Replay* replay, const char* filename);
+int replay_load(Replay* replay, const char* filename);
+
+void replay_free(Replay* replay);
+
+// Fold 32-bit words into an FNV-1a hash, byte by byte, little-endian
+uint32_t replay_hash(uint32_t hash, const int32_t* words, size_t count);
+
+#endif // _REPLAY_H